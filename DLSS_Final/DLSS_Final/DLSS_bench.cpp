@@ -0,0 +1,300 @@
+// Benchmark harness for the Sudoku solvers.
+// Separate build target: compiles DLSS_final.cpp with its main() disabled, e.g.
+//   g++ -std=c++14 -O2 -pthread DLSS_bench.cpp -o DLSS_bench
+// Runs every engine / storage mode over the bundled difficulty files and any
+// extra corpora, and reports per-solve latency percentiles, throughput and
+// heap allocations per solve as a table, CSV or JSON.
+#define DLSS_FINAL_NO_MAIN
+#include "DLSS_final.cpp"
+
+#include <cstdlib>         // malloc / free for the counting allocator
+#include <new>             // bad_alloc
+#include <iomanip>         // Table formatting
+
+// ----------------- Allocation counting -----------------
+// Every global operator new bumps this counter, so the harness can report
+// allocations per solve.
+static atomic<uint64_t> allocations{ 0 };
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+// GCC flags free() on memory from a replaced operator new once both are inlined
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete[](p); }
+
+// ----------------- Benchmark configurations -----------------
+
+struct Corpus {
+    string name;
+    vector<Grid> puzzles;
+};
+
+// One engine / storage mode; solve() returns whether the puzzle was solved
+struct BenchConfig {
+    string name;
+    function<bool(const Grid&, Grid&)> solve;
+};
+
+vector<BenchConfig> makeConfigs() {
+    vector<BenchConfig> configs;
+
+    // Original flow: fresh pointer-linked matrix per puzzle
+    configs.push_back({ "dlx-pointer", [](const Grid& p, Grid& out) {
+        DLX dlx(COLS);
+        buildSudokuDLX(dlx);
+        if (!applyInitialSudoku(dlx, p) || !dlx.search()) return false;
+        out = extractSolution(dlx.solution);
+        return true;
+    } });
+
+    // Fresh arena matrix per puzzle
+    configs.push_back({ "dlx-arena", [](const Grid& p, Grid& out) {
+        SudokuDLX dlx(COLS, 4 * N * N2);
+        buildSudokuDLX(dlx);
+        if (!applyInitialSudoku(dlx, p) || !dlx.search()) return false;
+        out = extractSolution(dlx.solution);
+        return true;
+    } });
+
+    // Long-lived solver restoring a prebuilt arena
+    auto reuse = make_shared<SudokuSolver>();
+    configs.push_back({ "dlx-arena-reuse", [reuse](const Grid& p, Grid& out) {
+        if (!reuse->solve(p)) return false;
+        out = extractSolution(reuse->solution());
+        return true;
+    } });
+
+    // Same, with the full minimum-size column scan instead of the early exit
+    auto minScan = make_shared<SudokuSolver>();
+    minScan->dlx.columnSelection = ColumnSelection::MinScan;
+    configs.push_back({ "dlx-arena-minscan", [minScan](const Grid& p, Grid& out) {
+        if (!minScan->solve(p)) return false;
+        out = extractSolution(minScan->solution());
+        return true;
+    } });
+
+    // One puzzle at a time, its search tree split across a pool
+    auto pool = make_shared<WorkStealingPool>();
+    auto parallel = make_shared<SudokuSolver>();
+    configs.push_back({ "dlx-arena-parallel", [pool, parallel](const Grid& p, Grid& out) {
+        if (!solveSudokuParallel(*parallel, p, *pool)) return false;
+        out = extractSolution(parallel->solution());
+        return true;
+    } });
+
+    auto bitboard = make_shared<BitboardSolver>();
+    configs.push_back({ "bitboard", [bitboard](const Grid& p, Grid& out) {
+        if (!bitboard->solve(p)) return false;
+        out = extractSolution(bitboard->solution());
+        return true;
+    } });
+
+    return configs;
+}
+
+// ----------------- Measurement -----------------
+
+struct BenchResult {
+    string corpus, config;
+    size_t solves = 0, solved = 0;
+    double p50 = 0, p99 = 0, max = 0;   // microseconds per solve
+    double perSecond = 0;               // solves per second
+    double allocsPerSolve = 0;
+};
+
+// Run config over the corpus `passes` times, timing every solve
+BenchResult runBench(const Corpus& corpus, const BenchConfig& config, int passes) {
+    BenchResult res;
+    res.corpus = corpus.name;
+    res.config = config.name;
+
+    Grid out{};
+    if (!corpus.puzzles.empty()) config.solve(corpus.puzzles[0], out); // warm up
+
+    vector<double> micros;
+    micros.reserve(corpus.puzzles.size() * passes);
+    double total = 0;
+    uint64_t allocs = 0;
+
+    for (int pass = 0; pass < passes; pass++) {
+        for (const Grid& p : corpus.puzzles) {
+            uint64_t a0 = allocations.load(memory_order_relaxed);
+            auto t0 = chrono::steady_clock::now();
+            bool ok = config.solve(p, out);
+            auto t1 = chrono::steady_clock::now();
+            allocs += allocations.load(memory_order_relaxed) - a0;
+
+            double us = chrono::duration<double, micro>(t1 - t0).count();
+            micros.push_back(us);
+            total += us;
+            res.solved += ok;
+        }
+    }
+
+    res.solves = micros.size();
+    if (res.solves == 0) return res;
+
+    sort(micros.begin(), micros.end());
+    res.p50 = micros[res.solves / 2];
+    res.p99 = micros[min(res.solves - 1, res.solves * 99 / 100)];
+    res.max = micros.back();
+    res.perSecond = total > 0 ? res.solves / (total * 1e-6) : 0;
+    res.allocsPerSolve = (double)allocs / res.solves;
+    return res;
+}
+
+// ----------------- Reporting -----------------
+
+void printText(ostream& out, const vector<BenchResult>& results) {
+    out << left << setw(18) << "corpus" << setw(18) << "config"
+        << right << setw(9) << "solves" << setw(9) << "solved"
+        << setw(11) << "p50 us" << setw(11) << "p99 us" << setw(11) << "max us"
+        << setw(13) << "solves/s" << setw(11) << "allocs" << '\n';
+    out << fixed;
+    for (const auto& r : results) {
+        out << left << setw(18) << r.corpus << setw(18) << r.config
+            << right << setw(9) << r.solves << setw(9) << r.solved
+            << setprecision(1) << setw(11) << r.p50 << setw(11) << r.p99 << setw(11) << r.max
+            << setprecision(0) << setw(13) << r.perSecond
+            << setprecision(1) << setw(11) << r.allocsPerSolve << '\n';
+    }
+}
+
+void printCsv(ostream& out, const vector<BenchResult>& results) {
+    out << "corpus,config,solves,solved,p50_us,p99_us,max_us,solves_per_s,allocs_per_solve\n";
+    for (const auto& r : results) {
+        out << r.corpus << ',' << r.config << ',' << r.solves << ',' << r.solved << ','
+            << r.p50 << ',' << r.p99 << ',' << r.max << ',' << r.perSecond << ','
+            << r.allocsPerSolve << '\n';
+    }
+}
+
+void printJson(ostream& out, const vector<BenchResult>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        out << "  {\"corpus\": \"" << r.corpus << "\", \"config\": \"" << r.config
+            << "\", \"solves\": " << r.solves << ", \"solved\": " << r.solved
+            << ", \"p50_us\": " << r.p50 << ", \"p99_us\": " << r.p99 << ", \"max_us\": " << r.max
+            << ", \"solves_per_s\": " << r.perSecond
+            << ", \"allocs_per_solve\": " << r.allocsPerSolve << "}"
+            << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    out << "]\n";
+}
+
+// ----------------- main -----------------
+
+void printBenchUsage(const char* prog) {
+    cerr << "Usage: " << prog << " [--data <dir>] [--no-bundled] [--corpus <file>]...\n"
+        "    [--config <name>]... [--repeat <n>] [--format text|csv|json] [--out <file>]\n"
+        "  --data      directory holding easy.txt ... Impossible2.txt (default .)\n"
+        "  --corpus    extra puzzle file (line format, 9 lines of 9 numbers or packed)\n"
+        "  --config    only run this configuration (dlx-pointer, dlx-arena,\n"
+        "              dlx-arena-reuse, dlx-arena-minscan, dlx-arena-parallel,\n"
+        "              bitboard)\n"
+        "  --repeat    passes over each corpus (small corpora are repeated until\n"
+        "              they give at least 1000 samples)\n";
+}
+
+int main(int argc, char* argv[]) {
+    string dataDir = ".", format = "text", output;
+    bool bundled = true;
+    int repeat = 1;
+    vector<string> corpusFiles, only;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--data" && hasValue) dataDir = argv[++i];
+        else if (arg == "--no-bundled") bundled = false;
+        else if (arg == "--corpus" && hasValue) corpusFiles.push_back(argv[++i]);
+        else if (arg == "--config" && hasValue) only.push_back(argv[++i]);
+        else if (arg == "--format" && hasValue) format = argv[++i];
+        else if (arg == "--out" && hasValue) output = argv[++i];
+        else if (arg == "--repeat" && hasValue) {
+            if (!isInteger(argv[++i], repeat) || repeat < 1) {
+                cerr << "ERROR: --repeat needs a positive integer.\n";
+                return 1;
+            }
+        }
+        else {
+            printBenchUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (format != "text" && format != "csv" && format != "json") {
+        cerr << "ERROR: Unknown format '" << format << "'.\n";
+        return 1;
+    }
+
+    vector<Corpus> corpora;
+    if (bundled) {
+        for (const char* name : { "easy", "medium", "hard", "impossible", "Impossible2" }) {
+            Corpus c;
+            c.name = name;
+            if (!loadPuzzleFile(dataDir + "/" + name + ".txt", c.puzzles)) {
+                cerr << "ERROR: Could not open " << dataDir << "/" << name << ".txt (use --data).\n";
+                return 1;
+            }
+            corpora.push_back(std::move(c));
+        }
+    }
+    for (const string& path : corpusFiles) {
+        Corpus c;
+        c.name = path.substr(path.find_last_of("/\\") + 1);
+        if (!loadPuzzleFile(path, c.puzzles)) {
+            cerr << "ERROR: Could not open " << path << ".\n";
+            return 1;
+        }
+        corpora.push_back(std::move(c));
+    }
+
+    vector<BenchConfig> configs;
+    for (auto& c : makeConfigs()) {
+        if (only.empty() || find(only.begin(), only.end(), c.name) != only.end())
+            configs.push_back(c);
+    }
+    if (configs.empty()) {
+        cerr << "ERROR: No configuration matches --config.\n";
+        return 1;
+    }
+
+    vector<BenchResult> results;
+    for (const Corpus& corpus : corpora) {
+        if (corpus.puzzles.empty()) continue;
+        int passes = max(repeat, (int)((1000 + corpus.puzzles.size() - 1) / corpus.puzzles.size()));
+        for (const BenchConfig& config : configs)
+            results.push_back(runBench(corpus, config, passes));
+    }
+
+    ofstream fout;
+    if (!output.empty()) {
+        fout.open(output);
+        if (!fout) {
+            cerr << "ERROR: Could not open output file " << output << ".\n";
+            return 1;
+        }
+    }
+    ostream& out = output.empty() ? cout : fout;
+
+    if (format == "csv")       printCsv(out, results);
+    else if (format == "json") printJson(out, results);
+    else                       printText(out, results);
+    return 0;
+}
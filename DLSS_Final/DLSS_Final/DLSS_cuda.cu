@@ -0,0 +1,175 @@
+// CUDA batch backend for 9x9 puzzles: one puzzle per thread, bitmask
+// candidates and an iterative most-constrained-cell backtracking search with
+// an undo stack (no board copies, so the state stays in registers / local
+// memory). See DLSS_cuda.h for the interface and build line.
+#include "DLSS_cuda.h"
+
+// Only nvcc builds this file (see DLSS_cuda.h); a plain C++ compiler sees
+// just the header
+#ifdef __CUDACC__
+
+#include <cuda_runtime.h>
+#include <cstdio>          // snprintf for error messages
+
+namespace {
+
+const unsigned ALL = 0x1FF; // digits 1..9 as bits 0..8
+
+__device__ inline int bitCount(unsigned m) { return __popc(m); }
+__device__ inline int lowestBit(unsigned m) { return __ffs(m) - 1; }
+
+__device__ inline int boxOf(int cell) {
+    return (cell / 27) * 3 + (cell % 9) / 3;
+}
+
+// Solve one puzzle into out; returns a GpuStatus
+__device__ uint8_t solveOne(const uint8_t* puzzle, uint8_t* out, uint32_t maxSteps) {
+    uint16_t rows[9] = {}, cols[9] = {}, boxes[9] = {};
+    uint8_t empties[81];        // unfilled cells; empties[0..depth) are placed
+    uint16_t remaining[81];     // digits still to try at each depth
+    int count = 0;
+
+    for (int i = 0; i < 81; i++) {
+        int d = puzzle[i];
+        out[i] = (uint8_t)d;
+        if (d == 0) {
+            empties[count++] = (uint8_t)i;
+            continue;
+        }
+        if (d > 9) return GPU_NO_SOLUTION;
+        unsigned bit = 1u << (d - 1);
+        int r = i / 9, c = i % 9, b = boxOf(i);
+        if ((rows[r] | cols[c] | boxes[b]) & bit) return GPU_NO_SOLUTION;
+        rows[r] |= bit;
+        cols[c] |= bit;
+        boxes[b] |= bit;
+    }
+
+    uint32_t steps = 0;
+    int depth = 0;
+    bool descend = true;
+    while (true) {
+        if (descend) {
+            if (depth == count) return GPU_SOLVED;
+            if (++steps > maxSteps) return GPU_GAVE_UP;
+
+            // Most constrained unfilled cell moves to position depth
+            int best = depth, bestCount = 10;
+            unsigned bestMask = 0;
+            for (int j = depth; j < count; j++) {
+                int i = empties[j];
+                unsigned m = ALL & ~(unsigned)(rows[i / 9] | cols[i % 9] | boxes[boxOf(i)]);
+                int n = bitCount(m);
+                if (n < bestCount) {
+                    best = j;
+                    bestCount = n;
+                    bestMask = m;
+                    if (n <= 1) break;
+                }
+            }
+            uint8_t t = empties[depth];
+            empties[depth] = empties[best];
+            empties[best] = t;
+            remaining[depth] = (uint16_t)bestMask;
+        }
+
+        int i = empties[depth];
+        int r = i / 9, c = i % 9, b = boxOf(i);
+        if (!descend) {         // back at this depth: take its digit out again
+            unsigned bit = 1u << (out[i] - 1);
+            rows[r] &= ~bit;
+            cols[c] &= ~bit;
+            boxes[b] &= ~bit;
+            out[i] = 0;
+        }
+
+        unsigned m = remaining[depth];
+        if (!m) {
+            if (depth == 0) return GPU_NO_SOLUTION;
+            depth--;
+            descend = false;
+            continue;
+        }
+        unsigned bit = m & (0u - m);
+        remaining[depth] = (uint16_t)(m & ~bit);
+        out[i] = (uint8_t)(lowestBit(bit) + 1);
+        rows[r] |= bit;
+        cols[c] |= bit;
+        boxes[b] |= bit;
+        depth++;
+        descend = true;
+    }
+}
+
+__global__ void solveKernel(const uint8_t* puzzles, uint8_t* solutions, uint8_t* status,
+                            size_t count, uint32_t maxSteps) {
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= count) return;
+    status[i] = solveOne(puzzles + 81 * i, solutions + 81 * i, maxSteps);
+}
+
+// Device buffers, kept between calls and grown as needed
+struct DeviceBuffers {
+    uint8_t* puzzles = nullptr;
+    uint8_t* solutions = nullptr;
+    uint8_t* status = nullptr;
+    size_t capacity = 0;
+
+    cudaError_t reserve(size_t count) {
+        if (count <= capacity) return cudaSuccess;
+        release();
+        cudaError_t e;
+        if ((e = cudaMalloc(&puzzles, count * 81)) != cudaSuccess) return e;
+        if ((e = cudaMalloc(&solutions, count * 81)) != cudaSuccess) return e;
+        if ((e = cudaMalloc(&status, count)) != cudaSuccess) return e;
+        capacity = count;
+        return cudaSuccess;
+    }
+
+    void release() {
+        cudaFree(puzzles);
+        cudaFree(solutions);
+        cudaFree(status);
+        puzzles = solutions = status = nullptr;
+        capacity = 0;
+    }
+};
+
+DeviceBuffers buffers;
+
+} // namespace
+
+bool cudaSolveBatch(const uint8_t* puzzles, size_t count, uint8_t* solutions, uint8_t* status,
+                    uint32_t maxSteps, char* error, size_t errorSize) {
+    if (count == 0) return true;
+
+    auto fail = [&](const char* what, cudaError_t e) {
+        snprintf(error, errorSize, "%s: %s", what, cudaGetErrorString(e));
+        return false;
+    };
+
+    int devices = 0;
+    cudaError_t e = cudaGetDeviceCount(&devices);
+    if (e != cudaSuccess) return fail("cudaGetDeviceCount", e);
+    if (devices == 0) {
+        snprintf(error, errorSize, "no CUDA device found");
+        return false;
+    }
+
+    if ((e = buffers.reserve(count)) != cudaSuccess) return fail("cudaMalloc", e);
+    if ((e = cudaMemcpy(buffers.puzzles, puzzles, count * 81, cudaMemcpyHostToDevice)) != cudaSuccess)
+        return fail("cudaMemcpy to device", e);
+
+    const int THREADS = 128;
+    const unsigned blocks = (unsigned)((count + THREADS - 1) / THREADS);
+    solveKernel<<<blocks, THREADS>>>(buffers.puzzles, buffers.solutions, buffers.status, count, maxSteps);
+    if ((e = cudaGetLastError()) != cudaSuccess) return fail("kernel launch", e);
+
+    if ((e = cudaMemcpy(solutions, buffers.solutions, count * 81, cudaMemcpyDeviceToHost)) != cudaSuccess)
+        return fail("cudaMemcpy from device", e);
+    if ((e = cudaMemcpy(status, buffers.status, count, cudaMemcpyDeviceToHost)) != cudaSuccess)
+        return fail("cudaMemcpy from device", e);
+    return true;
+}
+
+#endif
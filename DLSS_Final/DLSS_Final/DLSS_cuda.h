@@ -0,0 +1,27 @@
+// Interface between DLSS_final.cpp and the optional CUDA batch backend in
+// DLSS_cuda.cu. Only used when DLSS_final.cpp is built with DLSS_WITH_CUDA:
+//   nvcc -O3 -c DLSS_cuda.cu -o DLSS_cuda.o
+//   g++ -std=c++14 -O2 -pthread -DDLSS_WITH_CUDA DLSS_final.cpp DLSS_cuda.o -lcudart
+#ifndef DLSS_CUDA_H
+#define DLSS_CUDA_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-puzzle outcome of a GPU batch
+enum GpuStatus : uint8_t {
+    GPU_NO_SOLUTION = 0,    // clues conflict or the search ran out of branches
+    GPU_SOLVED = 1,         // solution holds the completed grid
+    GPU_GAVE_UP = 2         // step limit reached; the caller solves it on the CPU
+};
+
+// Solve count 9x9 puzzles stored back to back (81 bytes each, row-major,
+// 0 = blank), one puzzle per GPU thread. solutions receives count * 81
+// bytes in the same layout (the grid extractSolution would produce), status
+// one GpuStatus per puzzle. maxSteps bounds each thread's search so one
+// hard puzzle cannot hold up its warp. Returns false with a message in
+// error if no device is usable or a CUDA call fails.
+bool cudaSolveBatch(const uint8_t* puzzles, size_t count, uint8_t* solutions, uint8_t* status,
+                    uint32_t maxSteps, char* error, size_t errorSize);
+
+#endif
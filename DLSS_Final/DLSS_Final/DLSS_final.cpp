@@ -2,11 +2,59 @@
 #include <iostream>        // Input/output (cout, cin)
 #include <utility>         // Utility helpers (std::pair, std::move) 
 #include <vector>          // Dynamic arrays (used for gride, node storage, etc.)
+#include <array>           // Fixed-size flat Sudoku grid
 #include <string>          // String handling for column names and user input
 #include <fstream>         // File input when loading Sudoku puzzles from disk
 #include <algorithm>       // Algorithms like std::shuffle, std::find, std::transform
 #include <cctype>          // Character classification (to lower for user input)
 #include <random>          // Random number generation for Sudoku puzzle generator
+#include <cstdint>         // Fixed-width index types for the arena DLX storage
+#include <limits>          // numeric_limits (arena index capacity)
+#include <stdexcept>       // length_error when a matrix outgrows its index type, invalid_argument
+#include <thread>          // Worker threads for batch solving
+#include <mutex>           // Work-stealing deque locks
+#include <condition_variable> // Idle workers sleep until work arrives
+#include <deque>           // Per-worker task deques
+#include <functional>      // Type-erased pool tasks
+#include <atomic>          // Pool bookkeeping counters
+#include <memory>          // unique_ptr for per-worker state
+#include <chrono>          // Batch throughput timing
+#include <exception>       // Forward task exceptions to the pool owner
+#include <unordered_map>   // Node -> arena index when cloning a pointer DLX
+#include <cstring>         // memchr / memset for the line-format parser
+#include <initializer_list> // Literal rows for ExactCoverProblem::addRow
+#if defined(_MSC_VER)
+#include <intrin.h>        // _BitScanForward for the bitboard engine, __cpuidex
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>     // SSE2 / AVX2 batch solution verifier
+#define DLSS_X86 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>      // NEON batch solution verifier
+#define DLSS_NEON 1
+#endif
+#if defined(_WIN32)
+#define NOMINMAX
+#include <winsock2.h>      // TCP sockets for --serve (before windows.h)
+#include <ws2tcpip.h>
+#include <windows.h>       // File mapping for large puzzle files
+#include <io.h>            // _read / _write on stdin / stdout for --serve
+#if defined(_MSC_VER)
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#else
+#include <fcntl.h>         // open
+#include <sys/mman.h>      // mmap for large puzzle files
+#include <sys/stat.h>      // fstat
+#include <unistd.h>        // close, read / write for --serve
+#include <sys/socket.h>    // TCP sockets for --serve
+#include <netinet/in.h>
+#include <netinet/tcp.h>   // TCP_NODELAY
+#include <arpa/inet.h>     // htonl / htons
+#include <cerrno>          // EINTR
+#include <csignal>         // ignore SIGPIPE when a client disconnects
+#endif
+#include "DLSS_cuda.h"     // GPU batch backend interface (linked with -DDLSS_WITH_CUDA)
 
 using namespace std;
 
@@ -35,14 +83,518 @@ struct Column : Node {
     }
 };
 
+// ----------------- Shared DLX algorithms ----------------- //
+
+// ----------------- Search statistics ----------------- //
+// Pass a SearchStats to search / next / resume / countSolutions /
+// forEachSolution to collect
+// counters for that run; read them afterwards. The default NoSearchStats
+// policy has empty inline hooks, so an uninstrumented search compiles to the
+// same loop as before.
+struct SearchStats {
+    static const int BRANCH_BUCKETS = 16;   // branching factor 0..14, last = 15+
+
+    uint64_t nodes = 0;         // Search nodes (column choices)
+    uint64_t covers = 0;        // cover() calls
+    uint64_t uncovers = 0;      // uncover() calls
+    uint64_t updates = 0;       // Node unlink / relink operations inside them
+    uint64_t backtracks = 0;    // Chosen rows taken back
+    uint64_t solutions = 0;     // Solutions reached
+    int      maxDepth = 0;      // Deepest level (rows chosen by the search)
+    uint64_t branching[BRANCH_BUCKETS] = {}; // Size of the chosen column per node
+
+    void reset() { *this = SearchStats(); }
+
+    void onNode(int depth, int branches) {
+        nodes++;
+        if (depth > maxDepth) maxDepth = depth;
+        branching[branches < BRANCH_BUCKETS - 1 ? branches : BRANCH_BUCKETS - 1]++;
+    }
+    void onCover() { covers++; }
+    void onUncover() { uncovers++; }
+    void onUpdate() { updates++; }
+    void onBacktrack() { backtracks++; }
+    void onSolution(int depth) {
+        solutions++;
+        if (depth > maxDepth) maxDepth = depth;
+    }
+};
+
+struct NoSearchStats {
+    void onNode(int, int) {}
+    void onCover() {}
+    void onUncover() {}
+    void onUpdate() {}
+    void onBacktrack() {}
+    void onSolution(int) {}
+};
+
+// Outcome of running (or resuming) a DLX search
+enum class SearchStatus {
+    Found,          // parked at a solution
+    Exhausted,      // no (further) solution
+    Paused,         // node limit reached; resume() continues where it stopped
+    BudgetExceeded  // a SearchBudget ran out; the search was abandoned
+};
+
+// Limits for one budgeted search; the defaults are unlimited. The node
+// limit is exact, the deadline and cancel token are polled every
+// SearchBudget::CHECK_NODES nodes.
+struct SearchBudget {
+    static const uint64_t CHECK_NODES = 1024;
+
+    uint64_t maxNodes = ~(uint64_t)0;       // search nodes since the search began
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+    const atomic<bool>* cancel = nullptr;   // another thread sets it to stop the search
+
+    // Deadline ms milliseconds from now
+    void setTimeout(double ms) {
+        deadline = chrono::steady_clock::now() +
+            chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(ms));
+    }
+
+    // Deadline passed or cancel requested?
+    bool expired() const {
+        if (cancel && cancel->load(memory_order_relaxed)) return true;
+        return deadline != chrono::steady_clock::time_point::max() &&
+            chrono::steady_clock::now() >= deadline;
+    }
+};
+
+const uint64_t SearchBudget::CHECK_NODES;
+
+// Read-only view of one solution's rowIDs, handed to forEachSolution
+// visitors. It aliases the matrix's solution vector, so it is only valid
+// during the visitor call.
+struct RowSpan {
+    const int* rows;
+    size_t count;
+
+    const int* begin() const { return rows; }
+    const int* end() const { return rows + count; }
+    size_t size() const { return count; }
+    int operator[](size_t i) const { return rows[i]; }
+};
+
+// One orbit of rows under a symmetry of the problem, for the ...ByOrbit
+// searches: a representative row and the orbit's size
+struct RowOrbit {
+    int rowID;
+    uint64_t size;
+};
+
+// a * b, or ~0 if that overflows (symmetry weights grow factorially)
+inline uint64_t saturatingMul(uint64_t a, uint64_t b) {
+    return a && b > ~(uint64_t)0 / a ? ~(uint64_t)0 : a * b;
+}
+
+// How search() picks the column to branch on
+enum class ColumnSelection {
+    MinScan,    // scan every live column for the smallest size (original)
+    EarlyExit   // same, but stop at the first column of size 0 or 1
+};
+
+// DLXCore holds cover / uncover / search once for every storage mode.
+// Derived supplies the link accessors for its node handle type:
+//   root(), L(h), R(h), U(h), D(h) (returning references), C(h), size(c), rowID(h),
+//   findRow(rowID) (Handle() if absent)
+template <class Derived, class Handle>
+class DLXCore {
+public:
+    vector<int> solution; // rowIDs of chosen rows (partial/full solution)
+    ColumnSelection columnSelection = ColumnSelection::EarlyExit;
+
+    // Standard DLX cover / uncover
+
+    void cover(Handle c) {
+        NoSearchStats st;
+        cover(c, st);
+    }
+
+    template <class Stats>
+    void cover(Handle c, Stats& st) {
+        Derived& m = self();
+        st.onCover();
+        m.L(m.R(c)) = m.L(c);
+        m.R(m.L(c)) = m.R(c);
+
+        for (Handle row = m.D(c); row != c; row = m.D(row)) {
+            for (Handle node = m.R(row); node != row; node = m.R(node)) {
+                m.U(m.D(node)) = m.U(node);
+                m.D(m.U(node)) = m.D(node);
+                m.size(m.C(node))--;
+                st.onUpdate();
+            }
+        }
+    }
+
+    void uncover(Handle c) {
+        NoSearchStats st;
+        uncover(c, st);
+    }
+
+    template <class Stats>
+    void uncover(Handle c, Stats& st) {
+        Derived& m = self();
+        st.onUncover();
+        for (Handle row = m.U(c); row != c; row = m.U(row)) {
+            for (Handle node = m.L(row); node != row; node = m.L(node)) {
+                m.size(m.C(node))++;
+                m.U(m.D(node)) = node;
+                m.D(m.U(node)) = node;
+                st.onUpdate();
+            }
+        }
+        m.L(m.R(c)) = c;
+        m.R(m.L(c)) = c;
+    }
+
+    // Take column c out of the header list before searching: a secondary
+    // column may be covered at most once but never has to be, so the search
+    // never branches on it
+    void makeSecondary(Handle c) {
+        Derived& m = self();
+        m.L(m.R(c)) = m.L(c);
+        m.R(m.L(c)) = m.R(c);
+        m.L(c) = m.R(c) = c;
+    }
+
+    // Cover every column touched by the row containing r
+    void coverRow(Handle r) {
+        Derived& m = self();
+        Handle cur = r;
+        do {
+            cover(m.C(cur));
+            cur = m.R(cur);
+        } while (cur != r);
+    }
+
+    // Undo coverRow(r)
+    void uncoverRow(Handle r) {
+        Derived& m = self();
+        Handle cur = r;
+        do {
+            cur = m.L(cur);
+            uncover(m.C(cur));
+        } while (cur != r);
+    }
+
+    // Can the row containing r still be chosen, i.e. does it share no
+    // column with a clue or chosen row? Covering a column unlinks its rows
+    // from their other columns and takes the column out of the header list.
+    bool rowAvailable(Handle r) {
+        Derived& m = self();
+        Handle cur = r;
+        do {
+            Handle c = m.C(cur);
+            if (m.U(m.D(cur)) != cur || m.R(m.L(c)) != c) return false;
+            cur = m.R(cur);
+        } while (cur != r);
+        return true;
+    }
+
+    // Find the first solution. Clues already covered stay part of the matrix;
+    // the chosen rows are appended to solution. On success the search stays
+    // parked at that solution, so next() can continue to the following one.
+    bool search() {
+        NoSearchStats st;
+        return search(st);
+    }
+
+    template <class Stats>
+    bool search(Stats& st) {
+        beginSearch();
+        return resume(~(uint64_t)0, st) == SearchStatus::Found;
+    }
+
+    // Budgeted search: Found or Exhausted like search(), or BudgetExceeded
+    // when the node limit, deadline or cancel token stops it first. Then the
+    // search is abandoned: matrix and solution are as before the call.
+    SearchStatus searchWithin(const SearchBudget& budget) {
+        NoSearchStats st;
+        return searchWithin(budget, st);
+    }
+
+    template <class Stats>
+    SearchStatus searchWithin(const SearchBudget& budget, Stats& st) {
+        beginSearch();
+        while (!budget.expired() && nodes < budget.maxNodes) {
+            uint64_t slice = min(SearchBudget::CHECK_NODES, budget.maxNodes - nodes);
+            SearchStatus status = run<true>(slice, st);
+            if (status != SearchStatus::Paused) return status;
+        }
+        abandonSearch();
+        return SearchStatus::BudgetExceeded;
+    }
+
+    // Continue a parked search to its next solution; false once exhausted
+    bool next() {
+        NoSearchStats st;
+        return next(st);
+    }
+
+    template <class Stats>
+    bool next(Stats& st) {
+        return phase != Phase::Idle && resume(~(uint64_t)0, st) == SearchStatus::Found;
+    }
+
+    // Start a new search from the current matrix state, abandoning any
+    // search still in progress
+    void beginSearch() {
+        if (phase != Phase::Idle) abandonSearch();
+
+        // Every level covers at least one column, so depth <= column count
+        size_t depth = (size_t)self().numColumns() + 1;
+        if (stack.size() < depth) stack.resize(depth);
+
+        level = 0;
+        nodes = 0;
+        solutionBase = solution.size();
+        phase = Phase::Enter;
+    }
+
+    // Run the search until it reaches a solution (Found), runs out of
+    // branches (Exhausted, matrix back to its pre-search state) or has
+    // visited maxNodes search nodes (Paused; call resume() again to go on).
+    SearchStatus resume(uint64_t maxNodes = ~(uint64_t)0) {
+        NoSearchStats st;
+        return run<true>(maxNodes, st);
+    }
+
+    template <class Stats>
+    SearchStatus resume(uint64_t maxNodes, Stats& st) {
+        return run<true>(maxNodes, st);
+    }
+
+    // Count the solutions of the current matrix, stopping as soon as limit
+    // have been found (limit = 2 is a uniqueness check). Nothing is written
+    // to solution; the matrix is left as it was. Abandons any parked search.
+    uint64_t countSolutions(uint64_t limit = ~(uint64_t)0) {
+        NoSearchStats st;
+        return countSolutions(limit, st);
+    }
+
+    template <class Stats>
+    uint64_t countSolutions(uint64_t limit, Stats& st) {
+        beginSearch();
+        uint64_t found = 0;
+        while (found < limit && run<false>(~(uint64_t)0, st) == SearchStatus::Found)
+            found++;
+        abandonSearch();
+        return found;
+    }
+
+    // Stream the solutions of the current matrix to visit(RowSpan), which
+    // returns true for the next one or false to stop. Each solution is
+    // visited while the search is parked on it, with nothing buffered; the
+    // visitor must not modify the matrix. Stops after limit solutions; the
+    // matrix and solution are left as they were. Returns solutions visited.
+    template <class Visitor>
+    uint64_t forEachSolution(Visitor&& visit, uint64_t limit = ~(uint64_t)0) {
+        NoSearchStats st;
+        return forEachSolution(visit, limit, st);
+    }
+
+    template <class Visitor, class Stats>
+    uint64_t forEachSolution(Visitor&& visit, uint64_t limit, Stats& st) {
+        beginSearch();
+        uint64_t found = 0;
+        while (found < limit && run<true>(~(uint64_t)0, st) == SearchStatus::Found) {
+            found++;
+            if (!visit(RowSpan{ solution.data(), solution.size() })) break;
+        }
+        abandonSearch();
+        return found;
+    }
+
+    // Symmetry breaking at the root. Pass the rows of one column grouped
+    // into orbits under a symmetry group of the current matrix (row
+    // permutations that map solutions to solutions), one RowOrbit per
+    // orbit. Every solution holds exactly one row of the column, and the
+    // solutions through rows of one orbit are images of each other, so
+    // only the representatives are searched. The count is exact (weighted
+    // by orbit size, stopping once it reaches limit); rows already ruled out
+    // by clues count zero. The matrix is left as it was.
+    uint64_t countSolutionsByOrbit(const vector<RowOrbit>& orbits, uint64_t limit = ~(uint64_t)0) {
+        Derived& m = self();
+        uint64_t total = 0;
+        for (const RowOrbit& o : orbits) {
+            if (total >= limit) break;
+            Handle r = m.findRow(o.rowID);
+            if (o.size == 0 || r == Handle() || !rowAvailable(r)) continue;
+            uint64_t left = limit - total;
+            m.coverRow(r);
+            uint64_t found = countSolutions(left / o.size + (left % o.size != 0));
+            uncoverRow(r);
+            total += min(saturatingMul(found, o.size), left);
+        }
+        return total;
+    }
+
+    // Stream the solutions through each orbit's representative row to
+    // visit(RowSpan, weight), where weight is the orbit size: the number of
+    // solutions the visited one stands for. Same visitor contract as
+    // forEachSolution; stops after limit visits. Returns solutions visited.
+    template <class Visitor>
+    uint64_t forEachSolutionByOrbit(const vector<RowOrbit>& orbits, Visitor&& visit,
+                                    uint64_t limit = ~(uint64_t)0) {
+        Derived& m = self();
+        uint64_t visited = 0;
+        bool stopped = false;
+        for (const RowOrbit& o : orbits) {
+            if (stopped || visited >= limit) break;
+            Handle r = m.findRow(o.rowID);
+            if (o.size == 0 || r == Handle() || !rowAvailable(r)) continue;
+            solution.push_back(o.rowID);
+            m.coverRow(r);
+            visited += forEachSolution([&](RowSpan s) {
+                return (stopped = !visit(s, o.size)) == false;
+            }, limit - visited);
+            uncoverRow(r);
+            solution.pop_back();
+        }
+        return visited;
+    }
+
+    // Undo every row the current search has chosen, leaving the matrix
+    // (and solution) as they were before beginSearch()
+    void abandonSearch() {
+        Derived& m = self();
+        while (level > 0) {
+            Handle r = stack[--level];
+            for (Handle j = m.L(r); j != r; j = m.L(j))
+                uncover(m.C(j));
+            uncover(m.C(r));
+        }
+        if (phase != Phase::Idle) solution.resize(solutionBase);
+        phase = Phase::Idle;
+    }
+
+    // Is a search parked at a solution or paused mid-way?
+    bool searching() const { return phase != Phase::Idle; }
+
+    // Search nodes (column choices) visited since beginSearch()
+    uint64_t searchNodes() const { return nodes; }
+
+    // Column the search branches on next (root() when none are left): the
+    // one with smallest size (heuristic). A size-0 column is a dead end and
+    // a size-1 column a forced move, so EarlyExit takes either at once
+    // instead of scanning on for a smaller one.
+    Handle chooseColumn() {
+        Derived& m = self();
+        const Handle head = m.root();
+        const int stopAt = columnSelection == ColumnSelection::EarlyExit ? 1 : -1;
+        Handle c = head;
+        int minSize = numeric_limits<int>::max();
+        for (Handle j = m.R(head); j != head; j = m.R(j)) {
+            if (m.size(j) < minSize) {
+                minSize = m.size(j);
+                c = j;
+                if (minSize <= stopAt) break;
+            }
+        }
+        return c;
+    }
+
+protected:
+    // Forget the search state without touching the links (the matrix has
+    // been overwritten, e.g. by ArenaDLX::restore)
+    void discardSearch() {
+        level = 0;
+        phase = Phase::Idle;
+    }
+
+private:
+    // Enter: about to choose a column at this level.
+    // Backtrack: move on to the next row of the previous level.
+    enum class Phase { Idle, Enter, Backtrack };
+
+    vector<Handle> stack;       // Row node chosen at each level (preallocated)
+    int    level = 0;           // Current search depth
+    uint64_t nodes = 0;         // Search nodes visited since beginSearch()
+    size_t solutionBase = 0;    // solution entries that predate the search (clues)
+    Phase  phase = Phase::Idle;
+
+    void recordSolution() {
+        solution.resize(solutionBase);
+        for (int l = 0; l < level; l++)
+            solution.push_back(self().rowID(stack[l]));
+    }
+
+    // The search loop; Record = false (counting) never touches solution
+    template <bool Record, class Stats>
+    SearchStatus run(uint64_t maxNodes, Stats& st) {
+        Derived& m = self();
+        const Handle head = m.root();
+        uint64_t visited = 0;
+
+        while (true) {
+            Handle r;
+            if (phase == Phase::Enter) {
+                if (m.R(head) == head) { // all constraints satisfied
+                    if (Record) recordSolution();
+                    st.onSolution(level);
+                    phase = Phase::Backtrack;
+                    return SearchStatus::Found;
+                }
+                if (visited == maxNodes) return SearchStatus::Paused;
+                visited++;
+                nodes++;
+
+                Handle c = chooseColumn();
+                st.onNode(level, m.size(c));
+                if (m.size(c) == 0) { // dead end
+                    phase = Phase::Backtrack;
+                    continue;
+                }
+
+                cover(c, st);
+                r = m.D(c);
+            }
+            else if (phase == Phase::Backtrack) {
+                if (level == 0) {
+                    phase = Phase::Idle;
+                    if (Record) solution.resize(solutionBase);
+                    return SearchStatus::Exhausted;
+                }
+                r = stack[--level];
+                st.onBacktrack();
+                for (Handle j = m.L(r); j != r; j = m.L(j))
+                    uncover(m.C(j), st);
+                r = m.D(r);
+            }
+            else {
+                return SearchStatus::Exhausted;
+            }
+
+            // Try row r at this level; reaching the column header means
+            // every row of the column has been tried
+            Handle c = m.C(r);
+            if (r == c) {
+                uncover(c, st);
+                phase = Phase::Backtrack;
+                continue;
+            }
+
+            stack[level++] = r;
+            for (Handle j = m.R(r); j != r; j = m.R(j))
+                cover(m.C(j), st);
+            phase = Phase::Enter;
+        }
+    }
+
+    Derived& self() { return static_cast<Derived&>(*this); }
+};
+
 // ----------------- DLX class ----------------- //
 // DLX: Dancing Links implmentation for exact-cover problems (e.g: Sudoku)
-class DLX {
+// Pointer storage: every node and column is its own heap object.
+class DLX : public DLXCore<DLX, Node*> {
 public:
     Column head;              // Anchor / header of the column list
     vector<Column*> cols;     // Column headers
     vector<Node*>   nodes;    // All data nodes in the matrix
-    vector<int>     solution; // rowIDs of chosen rows (partial/full solution)
+    vector<Node*>   rowHeads; // rowID -> first node added for that row (nullptr if none)
 
     // Prevents copyiny or moving (linked structure stores &head, can't be trivially copied)
     DLX(const DLX&) = delete;
@@ -78,339 +630,3596 @@ private:
         head.R = c;
     }
 
-public:
-    Node* addNode(int colIndex, int rowID) {
-        Column* c = cols[colIndex];
-        Node* n = new Node();
-        nodes.push_back(n);
+public:
+    Node* addNode(int colIndex, int rowID) {
+        Column* c = cols[colIndex];
+        Node* n = new Node();
+        nodes.push_back(n);
+
+        // Insert at bottom of column c (before c)
+        n->D = c;
+        n->U = c->U;
+        c->U->D = n;
+        c->U = n;
+
+        n->C = c;
+        c->size++;
+        n->rowID = rowID;
+
+        if (rowID >= 0) {
+            if ((size_t)rowID >= rowHeads.size()) rowHeads.resize(rowID + 1, nullptr);
+            if (!rowHeads[rowID]) rowHeads[rowID] = n;
+        }
+        return n;
+    }
+
+    // Make a circular doubly-linked row from the given nodes
+    static void linkRow(Node* const* row, int n) {
+        if (n <= 0) return;
+        for (int i = 0; i < n; i++) {
+            Node* a = row[i];
+            Node* b = row[(i + 1) % n];
+            a->R = b;
+            b->L = a;
+        }
+    }
+
+    static void linkRow(const std::vector<Node*>& row) {
+        linkRow(row.data(), (int)row.size());
+    }
+
+    // First node of the row with this rowID (nullptr if absent), O(1)
+    Node* findRow(int rowID) const {
+        if (rowID < 0 || (size_t)rowID >= rowHeads.size()) return nullptr;
+        return rowHeads[rowID];
+    }
+
+    int numColumns() const { return (int)cols.size(); }
+
+    // Link accessors used by DLXCore
+    Node* root() { return &head; }
+    static Node*& L(Node* n) { return n->L; }
+    static Node*& R(Node* n) { return n->R; }
+    static Node*& U(Node* n) { return n->U; }
+    static Node*& D(Node* n) { return n->D; }
+    static Node* C(Node* n) { return n->C; }
+    static int& size(Node* c) { return static_cast<Column*>(c)->size; }
+    static int rowID(Node* n) { return n->rowID; }
+};
+
+// ----------------- Arena DLX class ----------------- //
+// ArenaDLX: same matrix as DLX, but the header, column headers and data nodes
+// live in one contiguous array and link to each other by Index, not pointer.
+// Entry 0 is the header, entries 1..numCols the column headers, then data nodes.
+// With Index = uint16_t a full 9x9 Sudoku matrix (1 + 324 + 2916 entries) is ~32 KB.
+// Links hold no addresses, so the whole matrix can be copied like a value.
+template <class Index>
+class ArenaDLX : public DLXCore<ArenaDLX<Index>, Index> {
+public:
+    struct Links {
+        Index L, R, U, D;   // Neighboring entries (left, right, up, down)
+        Index C;            // Column header this entry belongs to
+    };
+
+    vector<Links> links;    // Header, column headers and data nodes
+    vector<int>   sizes;    // Number of data nodes per column (indexed by entry)
+    vector<int>   rowIDs;   // rowID of every entry (-1 for headers)
+    vector<Index> rowHeads; // rowID -> first node added for that row (0 if none)
+
+    // Constructor: create numCols columns; nodeCapacity reserves room for data nodes
+    explicit ArenaDLX(int numCols, int nodeCapacity = 0) : colCount(numCols) {
+        links.reserve(1 + numCols + nodeCapacity);
+        rowIDs.reserve(1 + numCols + nodeCapacity);
+        newEntry(-1); // header is a self-loop
+
+        sizes.assign(1 + numCols, 0);
+        for (int i = 0; i < numCols; i++) {
+            Index c = newEntry(-1);
+            links[c].C = c; // Column header's C points to itself
+            insertColumn(c);
+        }
+    }
+
+private:
+    int colCount;       // Number of column headers
+
+    // Append a self-looped entry to the arena
+    Index newEntry(int rowID) {
+        if (links.size() > (size_t)numeric_limits<Index>::max())
+            throw length_error("ArenaDLX: matrix does not fit the index type");
+        Index n = (Index)links.size();
+        links.push_back({ n, n, n, n, n });
+        rowIDs.push_back(rowID);
+        return n;
+    }
+
+    // Insert c (a new column) immediately to the right of head
+    void insertColumn(Index c) {
+        links[c].R = links[0].R;
+        links[c].L = 0;
+        links[links[0].R].L = c;
+        links[0].R = c;
+    }
+
+public:
+    int numColumns() const { return colCount; }
+
+    // Reset this matrix to the state of pristine (same shape): a flat copy of
+    // the link and size arrays, no allocation once the storage exists
+    void restore(const ArenaDLX& pristine) {
+        links = pristine.links;
+        sizes = pristine.sizes;
+        if (rowIDs.size() != pristine.rowIDs.size()) {
+            rowIDs = pristine.rowIDs;     // rowIDs and rowHeads never change
+            rowHeads = pristine.rowHeads; // once the matrix is built
+        }
+        colCount = pristine.colCount;
+        this->solution.clear();
+        this->discardSearch();
+    }
+
+    // Arena index of the header for column colIndex
+    static Index column(int colIndex) { return (Index)(colIndex + 1); }
+
+    Index addNode(int colIndex, int rowID) {
+        Index c = column(colIndex);
+        Index n = newEntry(rowID);
+
+        // Insert at bottom of column c (before c)
+        links[n].D = c;
+        links[n].U = links[c].U;
+        links[links[c].U].D = n;
+        links[c].U = n;
+
+        links[n].C = c;
+        sizes[c]++;
+
+        if (rowID >= 0) {
+            if ((size_t)rowID >= rowHeads.size()) rowHeads.resize(rowID + 1, 0);
+            if (!rowHeads[rowID]) rowHeads[rowID] = n;
+        }
+        return n;
+    }
+
+    // Make a circular doubly-linked row from the given nodes
+    void linkRow(const Index* row, int n) {
+        if (n <= 0) return;
+        for (int i = 0; i < n; i++) {
+            Index a = row[i];
+            Index b = row[(i + 1) % n];
+            links[a].R = b;
+            links[b].L = a;
+        }
+    }
+
+    void linkRow(const std::vector<Index>& row) {
+        linkRow(row.data(), (int)row.size());
+    }
+
+    // First node of the row with this rowID (0 if absent), O(1)
+    Index findRow(int rowID) const {
+        if (rowID < 0 || (size_t)rowID >= rowHeads.size()) return 0;
+        return rowHeads[rowID];
+    }
+
+    // Link accessors used by DLXCore
+    Index root() const { return 0; }
+    Index& L(Index n) { return links[n].L; }
+    Index& R(Index n) { return links[n].R; }
+    Index& U(Index n) { return links[n].U; }
+    Index& D(Index n) { return links[n].D; }
+    Index C(Index n) const { return links[n].C; }
+    int& size(Index c) { return sizes[c]; }
+    int rowID(Index n) const { return rowIDs[n]; }
+};
+
+// Storage used by the Sudoku layer: one arena, 16-bit links
+using SudokuDLX = ArenaDLX<uint16_t>;
+
+// Clone a pointer-linked DLX into an arena, current state included (covered
+// columns stay covered, clue rows stay in solution). DLX itself cannot be
+// copied; the arena copy is a plain value that copies cheaply from then on.
+template <class Index>
+ArenaDLX<Index> toArena(const DLX& src) {
+    const int numCols = src.numColumns();
+    ArenaDLX<Index> dst(numCols, (int)src.nodes.size());
+
+    unordered_map<const Node*, Index> index;
+    index[&src.head] = dst.root();
+    for (int i = 0; i < numCols; i++)
+        index[src.cols[i]] = ArenaDLX<Index>::column(i);
+    for (const Node* n : src.nodes)     // same column, rowID and rowHeads
+        index[n] = dst.addNode(index[n->C] - 1, n->rowID);
+
+    auto copyLinks = [&](const Node* n) {
+        auto& l = dst.links[index[n]];
+        l.L = index[n->L];
+        l.R = index[n->R];
+        l.U = index[n->U];
+        l.D = index[n->D];
+    };
+    copyLinks(&src.head);
+    for (int i = 0; i < numCols; i++) {
+        copyLinks(src.cols[i]);
+        dst.sizes[ArenaDLX<Index>::column(i)] = src.cols[i]->size;
+    }
+    for (const Node* n : src.nodes) copyLinks(n);
+
+    dst.solution = src.solution;
+    dst.columnSelection = src.columnSelection;
+    return dst;
+}
+
+// ----------------- Exact-cover problem builder -----------------
+// A general exact-cover matrix given as sparse rows. Columns
+// 0..primary-1 are primary (covered exactly once); the secondary columns
+// after them may be covered at most once, e.g. the diagonals of N-queens.
+// Rows are kept in CSR form and laid out into an arena in one pass.
+class ExactCoverProblem {
+public:
+    explicit ExactCoverProblem(int primaryColumns, int secondaryColumns = 0)
+        : primary(primaryColumns), secondary(secondaryColumns),
+          rowStart(1, 0), seenInRow(max(0, primaryColumns + secondaryColumns), 0) {
+        if (primaryColumns < 0 || secondaryColumns < 0)
+            throw invalid_argument("ExactCoverProblem: negative column count");
+    }
+
+    int numPrimary() const { return primary; }
+    int numSecondary() const { return secondary; }
+    int numColumns() const { return primary + secondary; }
+    int numRows() const { return (int)rowIDs.size(); }
+    size_t numNodes() const { return columns.size(); }
+
+    void reserve(size_t rows, size_t nodes) {
+        rowStart.reserve(rows + 1);
+        rowIDs.reserve(rows);
+        columns.reserve(nodes);
+    }
+
+    // Append one row covering columns[0..count). rowID (what the solution
+    // reports) defaults to the row's position. Returns false, adding
+    // nothing, if a column is out of range or repeated within the row.
+    bool addRow(const int* cols, int count, int rowID = -1) {
+        if (count <= 0 || rowID < -1) return false;
+        const uint64_t stamp = ++calls;
+        for (int i = 0; i < count; i++) {
+            int c = cols[i];
+            if (c < 0 || c >= numColumns() || seenInRow[c] == stamp) return false;
+            seenInRow[c] = stamp;
+        }
+        rowIDs.push_back(rowID < 0 ? numRows() : rowID);
+        columns.insert(columns.end(), cols, cols + count);
+        rowStart.push_back((int)columns.size());
+        return true;
+    }
+
+    bool addRow(initializer_list<int> cols, int rowID = -1) {
+        return addRow(cols.begin(), (int)cols.size(), rowID);
+    }
+
+    // Append rowCount rows at once: row i covers
+    // cols[offsets[i]..offsets[i + 1]), offsets[0] = 0. rowIDs may be null.
+    // All or nothing: false if any row is rejected by addRow's rules.
+    bool addRows(const int* offsets, size_t rowCount, const int* cols, const int* ids = nullptr) {
+        const size_t rows = rowIDs.size(), nodes = columns.size();
+        reserve(rows + rowCount, nodes + (rowCount ? (size_t)offsets[rowCount] : 0));
+        for (size_t i = 0; i < rowCount; i++) {
+            int begin = offsets[i], end = offsets[i + 1];
+            if (end < begin || !addRow(cols + begin, end - begin, ids ? ids[i] : -1)) {
+                rowStart.resize(rows + 1);
+                rowIDs.resize(rows);
+                columns.resize(nodes);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The matrix in arena form, rows in the order they were added. Throws
+    // length_error if it does not fit Index.
+    template <class Index>
+    ArenaDLX<Index> toArena() const {
+        using Arena = ArenaDLX<Index>;
+        const size_t entries = 1 + (size_t)numColumns() + columns.size();
+        if (entries - 1 > (size_t)numeric_limits<Index>::max())
+            throw length_error("ExactCoverProblem: matrix does not fit the index type");
+
+        Arena dlx(numColumns(), (int)columns.size());
+        for (int c = primary; c < numColumns(); c++)
+            dlx.makeSecondary(Arena::column(c));
+
+        dlx.links.resize(entries);
+        dlx.rowIDs.resize(entries, -1);
+        int maxID = -1;
+        for (int id : rowIDs) maxID = max(maxID, id);
+        dlx.rowHeads.assign((size_t)(maxID + 1), 0);
+
+        // Nodes of a row are consecutive, so its left / right ring is
+        // implicit; each node goes to the bottom of its column
+        size_t n = 1 + (size_t)numColumns();
+        for (int row = 0; row < numRows(); row++) {
+            const size_t first = n, last = n + (rowStart[row + 1] - rowStart[row]) - 1;
+            for (int k = rowStart[row]; k < rowStart[row + 1]; k++, n++) {
+                Index c = Arena::column(columns[k]);
+                auto& l = dlx.links[n];
+                l.L = (Index)(n == first ? last : n - 1);
+                l.R = (Index)(n == last ? first : n + 1);
+                l.U = dlx.links[c].U;
+                l.D = c;
+                l.C = c;
+                dlx.links[l.U].D = (Index)n;
+                dlx.links[c].U = (Index)n;
+                dlx.sizes[c]++;
+                dlx.rowIDs[n] = rowIDs[row];
+            }
+            Index& head = dlx.rowHeads[rowIDs[row]];
+            if (!head) head = (Index)first;
+        }
+        return dlx;
+    }
+
+private:
+    int primary, secondary;
+    vector<int> rowStart;       // row i is columns[rowStart[i]..rowStart[i + 1])
+    vector<int> columns;
+    vector<int> rowIDs;
+    vector<uint64_t> seenInRow; // column -> last addRow call that used it (duplicate check)
+    uint64_t calls = 0;
+};
+
+// ----------------- Sudoku shape -----------------
+
+// Index math for a Sudoku with B x B boxes: N = B * B digits per unit, so
+// B = 3 is the classic 9x9, B = 4 is 16x16 and B = 5 is 25x25.
+// Everything is a compile-time constant, so each size gets its own
+// specialized encode / decode code (divisions by N, N2 and B become
+// multiply-and-shift, fixed-trip loops can be unrolled).
+template <int B>
+struct SudokuShape {
+    static_assert(B >= 2 && B <= 5, "SudokuShape: box size must be 2..5");
+
+    static constexpr int BOX = B;
+    static constexpr int N = B * B;        // digits, rows, columns and boxes
+    static constexpr int N2 = N * N;       // cells
+    static constexpr int COLS = 4 * N2;    // exact-cover constraint columns
+    static constexpr int ROWS = N * N2;    // candidate rows (r, c, d)
+
+    static constexpr int box(int r, int c) { return (r / B) * B + c / B; }
+
+    // Candidate (r, c, d) <-> rowID, d is 0-based
+    static constexpr int rowID(int r, int c, int d) { return r * N2 + c * N + d; }
+    static constexpr int cellOf(int rowID) { return rowID / N; }   // r * N + c
+    static constexpr int digitOf(int rowID) { return rowID % N; }
+
+    // The four constraint columns of candidate (r, c, d)
+    static constexpr int cellColumn(int r, int c) { return r * N + c; }
+    static constexpr int rowColumn(int r, int d) { return N2 + r * N + d; }
+    static constexpr int colColumn(int c, int d) { return 2 * N2 + c * N + d; }
+    static constexpr int boxColumn(int r, int c, int d) { return 3 * N2 + box(r, c) * N + d; }
+};
+
+template <int B> constexpr int SudokuShape<B>::BOX;
+template <int B> constexpr int SudokuShape<B>::N;
+template <int B> constexpr int SudokuShape<B>::N2;
+template <int B> constexpr int SudokuShape<B>::COLS;
+template <int B> constexpr int SudokuShape<B>::ROWS;
+
+// The same encode / decode math, tabulated per size at compile time so the
+// Sudoku layer reads it instead of dividing: cell -> (row, col, box) and
+// rowID -> cell, digit and its four constraint columns.
+template <int B>
+struct SudokuTables {
+    using S = SudokuShape<B>;
+    struct Cell { uint8_t row, col, box; };
+
+    Cell     cell[S::N2] = {};
+    uint16_t cellOf[S::ROWS] = {};      // rowID -> r * N + c
+    uint8_t  digitOf[S::ROWS] = {};     // rowID -> 0-based digit
+    uint16_t columns[S::ROWS][4] = {};  // rowID -> cell, row, col, box column
+    uint16_t unit[3 * S::N][S::N] = {}; // N rows, then N columns, then N boxes
+
+    constexpr SudokuTables() {
+        for (int r = 0; r < S::N; r++) {
+            for (int c = 0; c < S::N; c++) {
+                int i = r * S::N + c;
+                cell[i].row = (uint8_t)r;
+                cell[i].col = (uint8_t)c;
+                cell[i].box = (uint8_t)S::box(r, c);
+                unit[r][c] = (uint16_t)i;
+                unit[S::N + c][r] = (uint16_t)i;
+                unit[2 * S::N + S::box(r, c)][(r % B) * B + c % B] = (uint16_t)i;
+                for (int d = 0; d < S::N; d++) {
+                    int id = S::rowID(r, c, d);
+                    cellOf[id] = (uint16_t)i;
+                    digitOf[id] = (uint8_t)d;
+                    columns[id][0] = (uint16_t)S::cellColumn(r, c);
+                    columns[id][1] = (uint16_t)S::rowColumn(r, d);
+                    columns[id][2] = (uint16_t)S::colColumn(c, d);
+                    columns[id][3] = (uint16_t)S::boxColumn(r, c, d);
+                }
+            }
+        }
+    }
+};
+
+template <int B>
+constexpr SudokuTables<B> sudokuTables{};
+
+// ----------------- Sudoku grid -----------------
+
+// A grid stored flat in row-major order: cell (r, c) is grid[r * N + c],
+// 0 = empty. Trivially copyable, no heap allocation.
+template <int B>
+using BasicGrid = std::array<uint8_t, SudokuShape<B>::N2>;
+
+// The 9x9 grid: 81 bytes
+using Grid = BasicGrid<3>;
+
+// ----------------- Sudoku Generator -----------------
+
+// Digit-mask helpers for the generator and the bitboard engine
+#if defined(_MSC_VER)
+inline int bitCount(unsigned m) {
+    m = m - ((m >> 1) & 0x55555555u);
+    m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+    return (int)((((m + (m >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+}
+inline int lowestBit(unsigned m) {
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return (int)i;
+}
+#else
+inline int bitCount(unsigned m) { return __builtin_popcount(m); }
+inline int lowestBit(unsigned m) { return __builtin_ctz(m); }
+#endif
+
+// splitmix64 finalizer: decorrelates consecutive seeds
+inline uint64_t mixSeed(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// xoshiro256** PRNG: 32 bytes of state and a handful of shifts per draw.
+// Meets the UniformRandomBitGenerator requirements, so std::shuffle takes it.
+class Xoshiro256 {
+public:
+    using result_type = uint64_t;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~(result_type)0; }
+
+    explicit Xoshiro256(uint64_t s = 0) { seed(s); }
+
+    // State from the splitmix64 stream, which is never all zero
+    void seed(uint64_t s) {
+        for (uint64_t& w : state) {
+            w = mixSeed(s);
+            s += 0x9E3779B97F4A7C15ull;
+        }
+    }
+
+    result_type operator()() {
+        const uint64_t result = rotl(state[1] * 5, 7) * 9;
+        const uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+// Per-thread RNG for the interactive generator helpers
+static thread_local Xoshiro256 rng(((uint64_t)random_device{}() << 32) | random_device{}());
+
+// Value in [0, n) from one 32-bit draw (multiply-shift; bias below n / 2^32)
+template <class Rng>
+inline unsigned randomBelow(Rng& gen, unsigned n) {
+    return (unsigned)(((uint64_t)(uint32_t)gen() * n) >> 32);
+}
+
+// Fill the blank cells with a random valid completion, in row-major order.
+// Row / column / box digit masks give each cell's candidates directly and
+// a random one is drawn from the mask; backtracking walks an explicit
+// stack, so nothing is allocated. Given cells are kept; returns false if
+// they admit no completion.
+template <class Rng>
+bool fillSudoku(Grid& grid, Rng& gen) {
+    const auto& T = sudokuTables<3>;
+    const unsigned ALL = 0x1FF;
+    uint16_t rows[9] = {}, cols[9] = {}, boxes[9] = {};
+    uint8_t blanks[81];
+    uint16_t untried[81];   // candidates not yet tried at each depth
+    int count = 0;
+
+    for (int i = 0; i < 81; i++) {
+        if (!grid[i]) {
+            blanks[count++] = (uint8_t)i;
+            continue;
+        }
+        const auto& c = T.cell[i];
+        unsigned bit = 1u << (grid[i] - 1);
+        if ((rows[c.row] | cols[c.col] | boxes[c.box]) & bit) return false;
+        rows[c.row] |= bit;
+        cols[c.col] |= bit;
+        boxes[c.box] |= bit;
+    }
+
+    int depth = 0;
+    bool descend = true;
+    while (depth < count) {
+        int i = blanks[depth];
+        const auto& c = T.cell[i];
+        if (descend) {
+            untried[depth] = (uint16_t)(ALL & ~(rows[c.row] | cols[c.col] | boxes[c.box]));
+        }
+        else {  // back at this cell: take its digit out again
+            unsigned bit = 1u << (grid[i] - 1);
+            rows[c.row] &= ~bit;
+            cols[c.col] &= ~bit;
+            boxes[c.box] &= ~bit;
+            grid[i] = 0;
+        }
+
+        unsigned m = untried[depth];
+        if (!m) {
+            if (depth == 0) return false;
+            depth--;
+            descend = false;
+            continue;
+        }
+        for (unsigned k = randomBelow(gen, (unsigned)bitCount(m)); k > 0; k--)
+            m &= m - 1;     // drop the lowest candidate k times
+        unsigned bit = m & (0u - m);
+        untried[depth] &= (uint16_t)~bit;
+        grid[i] = (uint8_t)(lowestBit(bit) + 1);
+        rows[c.row] |= bit;
+        cols[c.col] |= bit;
+        boxes[c.box] |= bit;
+        depth++;
+        descend = true;
+    }
+    return true;
+}
+
+bool fillSudoku(Grid& grid) {
+    return fillSudoku(grid, rng);
+}
+
+// Remove <removeCount> random cells to make a puzzle
+Grid generateSudokuPuzzle(int removeCount = 40) {
+    Grid grid{};
+    fillSudoku(grid); // generate a complete valid solution
+
+    std::array<uint8_t, 81> pos;
+    for (int i = 0; i < 81; i++)
+        pos[i] = (uint8_t)i;
+
+    std::shuffle(pos.begin(), pos.end(), rng);
+
+    for (int k = 0; k < removeCount && k < 81; k++)
+        grid[pos[k]] = 0;
+
+    return grid;
+}
+
+// ----------------- Sudoku-specific helpers -----------------
+
+// The 9x9 shape, used by the engines and formats that only handle 9x9
+const int N = SudokuShape<3>::N;        // 9
+const int N2 = SudokuShape<3>::N2;      // 81
+const int COLS = SudokuShape<3>::COLS;  // 324 columns
+
+constexpr int boxIndex(int r, int c) {
+    return sudokuTables<3>.cell[r * N + c].box;
+}
+
+// Fill an existing DLX (any storage mode) with the full Sudoku exact-cover matrix
+template <int B = 3, class Matrix>
+void buildSudokuDLX(Matrix& dlx) {
+    using S = SudokuShape<B>;
+    using Handle = decltype(dlx.addNode(0, 0));
+    const SudokuTables<B>& t = sudokuTables<B>;
+
+    // One row per (row, col, digit), in rowID order; its four constraint
+    // columns are cell, row-digit, col-digit and box-digit
+    for (int rowID = 0; rowID < S::ROWS; rowID++) {
+        Handle rowNodes[4];
+        for (int i = 0; i < 4; i++)
+            rowNodes[i] = dlx.addNode(t.columns[rowID][i], rowID);
+        dlx.linkRow(rowNodes, 4);
+    }
+}
+
+// ----------------- Clue validation -----------------
+
+// Two clues that share a digit in one unit (first < second, flat cell
+// indices), or a clue outside 1..N (second == -1)
+struct ClueConflict {
+    int first, second;
+    int digit;
+    const char* unit;   // "row", "column" or "box" (nullptr for a bad digit)
+};
+
+// One O(N2) pass with a digit mask per row / column / box. Returns false as
+// soon as a clue conflicts; with conflicts non-null it instead reports every
+// pair (the earlier cell is only looked up on that slow path).
+template <int B = 3>
+bool validateClues(const BasicGrid<B>& grid, vector<ClueConflict>* conflicts = nullptr) {
+    using S = SudokuShape<B>;
+    uint32_t rows[S::N] = {}, cols[S::N] = {}, boxes[S::N] = {};
+    bool ok = true;
+
+    for (int i = 0; i < S::N2; i++) {
+        int d = grid[i];
+        if (d == 0) continue;
+        if (d > S::N) {
+            if (!conflicts) return false;
+            conflicts->push_back({ i, -1, d, nullptr });
+            ok = false;
+            continue;
+        }
+
+        const auto& cell = sudokuTables<B>.cell[i];
+        int r = cell.row, c = cell.col, b = cell.box;
+        uint32_t bit = 1u << (d - 1);
+        if ((rows[r] | cols[c] | boxes[b]) & bit) {
+            if (!conflicts) return false;
+            ok = false;
+
+            // Earliest cell of each unit already holding d
+            auto report = [&](const char* unit, int step, int start) {
+                for (int j = start; j < i; j += step) {
+                    if (grid[j] == d) {
+                        conflicts->push_back({ j, i, d, unit });
+                        return;
+                    }
+                }
+            };
+            if (rows[r] & bit) report("row", 1, r * S::N);
+            if (cols[c] & bit) report("column", S::N, c);
+            if (boxes[b] & bit) {
+                int top = (r / B) * B * S::N + (c / B) * B;
+                for (int k = 0; k < S::N; k++) {
+                    int j = top + (k / B) * S::N + k % B;
+                    if (j < i && grid[j] == d) {
+                        conflicts->push_back({ j, i, d, "box" });
+                        break;
+                    }
+                }
+            }
+        }
+        rows[r] |= bit;
+        cols[c] |= bit;
+        boxes[b] |= bit;
+    }
+    return ok;
+}
+
+// e.g. "row 1, column 1 and row 1, column 2 are both 5 (same row)"
+template <int B = 3>
+string describeConflict(const ClueConflict& k) {
+    const int n = SudokuShape<B>::N;
+    auto cell = [n](int i) {
+        return "row " + to_string(i / n + 1) + ", column " + to_string(i % n + 1);
+    };
+    if (k.second < 0)
+        return cell(k.first) + " holds " + to_string(k.digit) + ", outside 1-" + to_string(n);
+    return cell(k.first) + " and " + cell(k.second) + " are both " + to_string(k.digit) +
+        " (same " + k.unit + ")";
+}
+
+// Force the given clues into the DLX structure. Conflicting clues would
+// cover a column twice and corrupt the links, so they are rejected first:
+// false (matrix untouched) if validateClues fails.
+template <int B = 3, class Matrix>
+bool applyInitialSudoku(Matrix& dlx, const BasicGrid<B>& grid) {
+    using S = SudokuShape<B>;
+    if (!validateClues<B>(grid)) return false;
+
+    for (int i = 0; i < S::N2; i++) {
+        int d = grid[i];
+        if (d == 0) continue; // skip empty
+
+        int rowID = i * S::N + d - 1;   // S::rowID(r, c, d - 1)
+
+        auto rowNode = dlx.findRow(rowID);
+        if (!rowNode) {
+            const auto& cell = sudokuTables<B>.cell[i];
+            cerr << "ERROR: could not find rowID " << rowID
+                << " for given (" << (int)cell.row << "," << (int)cell.col << ")=" << d << endl;
+            continue;
+        }
+
+        // record given as part of solution
+        dlx.solution.push_back(rowID);
+
+        // cover all columns touched by this row
+        dlx.coverRow(rowNode);
+    }
+    return true;
+}
+
+template <class Matrix>
+bool solveSudoku(Matrix& dlx) {
+    return dlx.search();
+}
+
+// ----------------- Reusable Sudoku solver -----------------
+
+// The Sudoku matrix never changes between puzzles: build it once per process
+// (per size) and share it read-only. 16-bit links hold up to 25x25.
+template <int B = 3>
+const SudokuDLX& pristineSudokuDLX() {
+    using S = SudokuShape<B>;
+    static const SudokuDLX pristine = [] {
+        SudokuDLX dlx(S::COLS, 4 * S::ROWS);
+        buildSudokuDLX<B>(dlx);
+        return dlx;
+    }();
+    return pristine;
+}
+
+// Long-lived solver: owns one working matrix and restores it from the
+// pristine copy before each puzzle instead of rebuilding it
+template <int B>
+class BasicSudokuSolver {
+public:
+    using GridType = BasicGrid<B>;
+
+    SudokuDLX dlx;
+
+    BasicSudokuSolver() : dlx(pristineSudokuDLX<B>()) {}
+
+    // Back to the empty-puzzle state
+    void reset() { dlx.restore(pristineSudokuDLX<B>()); }
+
+    bool solve(const GridType& puzzle) {
+        reset();
+        return applyInitialSudoku<B>(dlx, puzzle) && solveSudoku(dlx);
+    }
+
+    // Same, collecting search counters into st
+    template <class Stats>
+    bool solve(const GridType& puzzle, Stats& st) {
+        reset();
+        return applyInitialSudoku<B>(dlx, puzzle) && dlx.search(st);
+    }
+
+    // Budgeted solve: Found, Exhausted (no solution) or BudgetExceeded
+    SearchStatus solveWithin(const GridType& puzzle, const SearchBudget& budget) {
+        reset();
+        if (!applyInitialSudoku<B>(dlx, puzzle)) return SearchStatus::Exhausted;
+        return dlx.searchWithin(budget);
+    }
+
+    template <class Stats>
+    SearchStatus solveWithin(const GridType& puzzle, const SearchBudget& budget, Stats& st) {
+        reset();
+        if (!applyInitialSudoku<B>(dlx, puzzle)) return SearchStatus::Exhausted;
+        return dlx.searchWithin(budget, st);
+    }
+
+    const vector<int>& solution() const { return dlx.solution; }
+
+    // Number of solutions of puzzle, counting stops at limit
+    uint64_t countSolutions(const GridType& puzzle, uint64_t limit = 2) {
+        reset();
+        if (!applyInitialSudoku<B>(dlx, puzzle)) return 0;
+        return dlx.countSolutions(limit);
+    }
+
+    // Stream puzzle's solutions (clue rows included) to visit(RowSpan);
+    // see DLXCore::forEachSolution
+    template <class Visitor>
+    uint64_t forEachSolution(const GridType& puzzle, Visitor&& visit, uint64_t limit = ~(uint64_t)0) {
+        reset();
+        if (!applyInitialSudoku<B>(dlx, puzzle)) return 0;
+        return dlx.forEachSolution(visit, limit);
+    }
+
+    bool hasUniqueSolution(const GridType& puzzle) {
+        return countSolutions(puzzle, 2) == 1;
+    }
+
+    // Counting and enumeration with the digit symmetry broken. Digits no
+    // clue uses are interchangeable: permuting them maps solutions to
+    // solutions and never fixes one, so the solutions fall into classes of
+    // k! for k unused digits. Every unit holds each unused digit, so the
+    // search first fills the blanks of the unit with the fewest, allowing
+    // an unused digit only if it is the smallest not yet placed there;
+    // exactly one solution per class survives. Puzzles that use all digits
+    // but one search exactly as before.
+
+    // Exact number of solutions, stopping once it reaches limit
+    uint64_t countSolutionsBySymmetry(const GridType& puzzle, uint64_t limit = ~(uint64_t)0) {
+        SymmetryPlan plan;
+        if (!planSymmetry(puzzle, plan)) return 0;
+        uint64_t need = limit / plan.weight + (limit % plan.weight != 0), found = 0;
+        auto leaf = [&] {
+            found += dlx.countSolutions(need - found);
+            return found < need;
+        };
+        fixFreeDigits(plan, 0, plan.freeDigits, leaf);
+        return min(saturatingMul(found, plan.weight), limit);
+    }
+
+    // Stream one solution per class to visit(RowSpan, weight), weight being
+    // the class size k!; otherwise as forEachSolution
+    template <class Visitor>
+    uint64_t forEachSolutionBySymmetry(const GridType& puzzle, Visitor&& visit, uint64_t limit = ~(uint64_t)0) {
+        SymmetryPlan plan;
+        if (!planSymmetry(puzzle, plan)) return 0;
+        uint64_t visited = 0;
+        bool stopped = false;
+        auto leaf = [&] {
+            visited += dlx.forEachSolution([&](RowSpan s) {
+                return (stopped = !visit(s, plan.weight)) == false;
+            }, limit - visited);
+            return !stopped && visited < limit;
+        };
+        fixFreeDigits(plan, 0, plan.freeDigits, leaf);
+        return visited;
+    }
+
+private:
+    using S = SudokuShape<B>;
+
+    struct SymmetryPlan {
+        int cells[S::N];            // blank cells of the unit filled first
+        int count = 0;
+        unsigned freeDigits = 0;    // bit d: digit d + 1 is in no clue
+        uint64_t weight = 1;        // solutions per class
+    };
+
+    // Apply the clues and pick the unit; false if the clues conflict
+    bool planSymmetry(const GridType& puzzle, SymmetryPlan& plan) {
+        reset();
+        if (!applyInitialSudoku<B>(dlx, puzzle)) return false;
+
+        unsigned used = 0;
+        for (int i = 0; i < S::N2; i++) {
+            if (puzzle[i]) used |= 1u << (puzzle[i] - 1);
+        }
+        const unsigned free = ((1u << S::N) - 1) & ~used;
+        const int k = bitCount(free);
+        if (k <= 1) return true;
+        plan.freeDigits = free;
+        for (int j = 2; j <= k; j++) plan.weight = saturatingMul(plan.weight, (uint64_t)j);
+
+        const auto& T = sudokuTables<B>;
+        int best = 0, bestBlanks = S::N + 1;
+        for (int u = 0; u < 3 * S::N; u++) {
+            int blanks = 0;
+            for (int j = 0; j < S::N; j++) blanks += puzzle[T.unit[u][j]] == 0;
+            if (blanks < bestBlanks) {
+                best = u;
+                bestBlanks = blanks;
+            }
+        }
+        for (int j = 0; j < S::N; j++) {
+            if (puzzle[T.unit[best][j]] == 0) plan.cells[plan.count++] = T.unit[best][j];
+        }
+        return true;
+    }
+
+    // Fill plan.cells[pos..] in order until every unused digit is down,
+    // then let leaf() search the rest; false once leaf() asks to stop
+    template <class Leaf>
+    bool fixFreeDigits(const SymmetryPlan& plan, int pos, unsigned free, Leaf& leaf) {
+        if (!free) return leaf();
+        if (pos == plan.count) return true;
+
+        const int cell = plan.cells[pos];
+        const int next = lowestBit(free);
+        for (int d = 0; d < S::N; d++) {
+            const bool isFree = (free >> d) & 1;
+            if (isFree && d != next) continue;
+            const int rowID = cell * S::N + d;     // S::rowID(r, c, d)
+            auto r = dlx.findRow(rowID);
+            if (!dlx.rowAvailable(r)) continue;
+
+            dlx.solution.push_back(rowID);
+            dlx.coverRow(r);
+            bool go = fixFreeDigits(plan, pos + 1, isFree ? free & ~(1u << d) : free, leaf);
+            dlx.uncoverRow(r);
+            dlx.solution.pop_back();
+            if (!go) return false;
+        }
+        return true;
+    }
+};
+
+using SudokuSolver = BasicSudokuSolver<3>;
+
+// ----------------- Unique puzzle generator -----------------
+
+// Difficulty is the number of DLX search nodes needed to solve a puzzle and
+// prove its solution unique
+enum class Difficulty { Any, Easy, Medium, Hard, Expert };
+
+struct DifficultyRange {
+    uint64_t minNodes, maxNodes;
+};
+
+DifficultyRange difficultyRange(Difficulty level) {
+    const uint64_t NONE = ~(uint64_t)0;
+    switch (level) {
+    case Difficulty::Easy:   return { 0, 58 };
+    case Difficulty::Medium: return { 59, 80 };
+    case Difficulty::Hard:   return { 81, 200 };
+    case Difficulty::Expert: return { 201, NONE };
+    default:                 return { 0, NONE };
+    }
+}
+
+// Per-thread generator: owns its RNG and solver, so generator threads never
+// share the global rng.
+// Clues are removed one at a time in random order; a removal is kept only if
+// the puzzle stays unique and no harder than the target range allows.
+class PuzzleGenerator {
+public:
+    explicit PuzzleGenerator(uint64_t seed = random_device{}()) : gen(seed) {}
+
+    void seed(uint64_t s) { gen.seed(s); }
+
+    // Generate a uniquely solvable puzzle in the level's node range. After
+    // maxAttempts grids without a match, keeps the last (still unique) try
+    // and returns false. nodes receives the puzzle's search node count.
+    bool generate(Difficulty level, Grid& puzzle, uint64_t* nodes = nullptr, int maxAttempts = 50) {
+        DifficultyRange range = difficultyRange(level);
+        uint64_t cost = 0;
+
+        for (int attempt = 0; attempt < maxAttempts; attempt++) {
+            Grid full{};
+            fillSudoku(full, gen);
+            puzzle = full;
+
+            std::array<uint8_t, 81> order;
+            for (int i = 0; i < 81; i++) order[i] = (uint8_t)i;
+            std::shuffle(order.begin(), order.end(), gen);
+
+            cost = 0;
+            for (int cell : order) {
+                uint8_t clue = puzzle[cell];
+                puzzle[cell] = 0;
+                if (solver.countSolutions(puzzle, 2) == 1 && solver.dlx.searchNodes() <= range.maxNodes)
+                    cost = solver.dlx.searchNodes();
+                else
+                    puzzle[cell] = clue; // needed for uniqueness (or too hard)
+            }
+
+            if (cost >= range.minNodes) {
+                if (nodes) *nodes = cost;
+                return true;
+            }
+        }
+        if (nodes) *nodes = cost;
+        return false;
+    }
+
+private:
+    Xoshiro256 gen;
+    SudokuSolver solver;
+};
+
+// ----------------- Bitboard Sudoku engine -----------------
+// Second 9x9 engine: per-row / per-column / per-box digit masks with
+// naked- and hidden-single propagation, branching on the cell with the
+// fewest candidates. Same solve()/solution() shape as SudokuSolver, so
+// extractSolution works unchanged; the generic DLX stays for other problems.
+
+// Cell -> row/column/box and unit -> cells tables for the bitboard engine
+struct BitboardTables {
+    uint8_t row[81] = {}, col[81] = {}, box[81] = {};
+    uint8_t unit[27][9] = {};   // 9 rows, then 9 columns, then 9 boxes
+
+    constexpr BitboardTables() {
+        for (int i = 0; i < 81; i++) {
+            row[i] = sudokuTables<3>.cell[i].row;
+            col[i] = sudokuTables<3>.cell[i].col;
+            box[i] = sudokuTables<3>.cell[i].box;
+        }
+        for (int i = 0; i < 9; i++) {
+            for (int j = 0; j < 9; j++) {
+                unit[i][j] = (uint8_t)(i * 9 + j);
+                unit[9 + i][j] = (uint8_t)(j * 9 + i);
+                unit[18 + i][j] = (uint8_t)((3 * (i / 3) + j / 3) * 9 + 3 * (i % 3) + j % 3);
+            }
+        }
+    }
+};
+
+constexpr BitboardTables bitboardTables{};
+
+class BitboardSolver {
+public:
+    bool solve(const Grid& puzzle) {
+        solutionRows.clear();
+
+        Board b;
+        if (!load(b, puzzle)) return false; // clues contradict each other
+        if (!search(b)) return false;
+
+        for (int i = 0; i < 81; i++)
+            solutionRows.push_back(i * 9 + b.cells[i] - 1); // rowID r*81 + c*9 + d
+        return true;
+    }
+
+    const vector<int>& solution() const { return solutionRows; }
+
+private:
+    static const unsigned ALL = 0x1FF; // digits 1..9 as bits 0..8
+
+    // Whole search state; small enough to copy at every branch instead of undoing
+    struct Board {
+        uint16_t rows[9] = {}, cols[9] = {}, boxes[9] = {}; // digits used per unit
+        uint8_t  cells[81] = {};                          // 0 = empty
+        int      empty = 81;                              // cells still unsolved
+
+        unsigned candidates(int i) const {
+            const BitboardTables& t = bitboardTables;
+            return ALL & ~(unsigned)(rows[t.row[i]] | cols[t.col[i]] | boxes[t.box[i]]);
+        }
+
+        // Digits already placed in unit u
+        unsigned used(int u) const {
+            if (u < 9)  return rows[u];
+            if (u < 18) return cols[u - 9];
+            return boxes[u - 18];
+        }
+
+        void place(int i, int d) {
+            const BitboardTables& t = bitboardTables;
+            uint16_t bit = (uint16_t)(1u << (d - 1));
+            cells[i] = (uint8_t)d;
+            rows[t.row[i]] |= bit;
+            cols[t.col[i]] |= bit;
+            boxes[t.box[i]] |= bit;
+            empty--;
+        }
+    };
+
+    vector<int> solutionRows; // rowIDs of the solved grid, like DLX::solution
+
+    static bool load(Board& b, const Grid& grid) {
+        for (int i = 0; i < 81; i++) {
+            int d = grid[i];
+            if (d == 0) continue;
+            if (d > 9) return false;
+            if (!(b.candidates(i) & (1u << (d - 1)))) return false;
+            b.place(i, d);
+        }
+        return true;
+    }
+
+    // Place naked and hidden singles until nothing changes; false on contradiction
+    static bool propagate(Board& b) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+
+            // Naked singles: a cell with exactly one candidate
+            for (int i = 0; i < 81; i++) {
+                if (b.cells[i]) continue;
+                unsigned cand = b.candidates(i);
+                if (!cand) return false;
+                if (!(cand & (cand - 1))) {
+                    b.place(i, lowestBit(cand) + 1);
+                    changed = true;
+                }
+            }
+            if (b.empty == 0) return true;
+
+            // Hidden singles: a digit with exactly one possible cell in a unit
+            for (int u = 0; u < 27; u++) {
+                const uint8_t* cells = bitboardTables.unit[u];
+                unsigned once = 0, twice = 0;
+                for (int k = 0; k < 9; k++) {
+                    if (b.cells[cells[k]]) continue;
+                    unsigned cand = b.candidates(cells[k]);
+                    twice |= once & cand;
+                    once |= cand;
+                }
+                if ((once | b.used(u)) != ALL) return false; // digit with no place left
+
+                unsigned hidden = once & ~twice;
+                while (hidden) {
+                    unsigned bit = hidden & (0u - hidden);
+                    hidden &= hidden - 1;
+
+                    int k = 0;
+                    while (k < 9 && (b.cells[cells[k]] || !(b.candidates(cells[k]) & bit))) k++;
+                    if (k == 9) return false; // its only cell took another hidden single
+                    b.place(cells[k], lowestBit(bit) + 1);
+                    changed = true;
+                }
+            }
+        }
+        return true;
+    }
+
+    static bool search(Board& b) {
+        if (!propagate(b)) return false;
+        if (b.empty == 0) return true;
+
+        // Branch on the unsolved cell with the fewest candidates
+        int best = -1, bestCount = 10;
+        for (int i = 0; i < 81 && bestCount > 2; i++) {
+            if (b.cells[i]) continue;
+            int n = bitCount(b.candidates(i));
+            if (n < bestCount) {
+                bestCount = n;
+                best = i;
+            }
+        }
+
+        unsigned cand = b.candidates(best);
+        while (cand) {
+            int d = lowestBit(cand) + 1;
+            cand &= cand - 1;
+
+            Board next = b;
+            next.place(best, d);
+            if (search(next)) {
+                b = next;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Convert solution rowIDs back into a grid
+template <int B = 3>
+BasicGrid<B> extractSolution(RowSpan solution) {
+    const SudokuTables<B>& t = sudokuTables<B>;
+    BasicGrid<B> grid{};
+
+    for (int rowID : solution)
+        grid[t.cellOf[rowID]] = (uint8_t)(t.digitOf[rowID] + 1);
+    return grid;
+}
+
+template <int B = 3>
+BasicGrid<B> extractSolution(const vector<int>& solution) {
+    return extractSolution<B>(RowSpan{ solution.data(), solution.size() });
+}
+
+// ----------------- Logical pre-solver -----------------
+// Human-style propagation over per-cell candidate masks: naked singles,
+// hidden singles and locked candidates (pointing and claiming), repeated
+// until none applies. Most published puzzles need nothing more; whatever
+// is left goes to the search. The report doubles as a difficulty grade.
+
+// Which techniques a propagation used
+struct LogicReport {
+    int nakedSingles = 0;       // cells placed as the only digit that fits
+    int hiddenSingles = 0;      // cells placed as a digit's only spot in a unit
+    int lockedCandidates = 0;   // candidates removed by pointing / claiming
+    bool solved = false;        // logic alone completed the grid
+    bool contradiction = false; // the clues cannot be completed
+
+    int placed() const { return nakedSingles + hiddenSingles; }
+
+    // Hardest step needed, from "none" (grid was full) to "search"
+    const char* hardest() const {
+        if (contradiction) return "contradiction";
+        if (!solved) return "search";
+        if (lockedCandidates) return "locked candidates";
+        if (hiddenSingles) return "hidden single";
+        if (nakedSingles) return "naked single";
+        return "none";
+    }
+};
+
+// Fill the cells of grid that logic forces, in place. False (report says
+// contradiction) when the clues conflict or propagation runs out of
+// candidates somewhere; the grid is then partly filled.
+template <int B = 3>
+bool presolveSudoku(BasicGrid<B>& grid, LogicReport* report = nullptr) {
+    using S = SudokuShape<B>;
+    const SudokuTables<B>& t = sudokuTables<B>;
+    const uint32_t ALL = (1u << S::N) - 1;     // digits 1..N as bits 0..N-1
+
+    LogicReport rep;
+    auto finish = [&](bool ok) {
+        rep.contradiction = !ok;
+        if (report) *report = rep;
+        return ok;
+    };
+    if (!validateClues<B>(grid)) return finish(false);
+
+    uint32_t cand[S::N2];
+    int empty = 0;
+    for (int i = 0; i < S::N2; i++) {
+        cand[i] = grid[i] ? 0 : ALL;
+        empty += !grid[i];
+    }
+    auto eliminatePeers = [&](int i, uint32_t bit) {
+        const auto& cell = t.cell[i];
+        const uint16_t* units[3] = { t.unit[cell.row], t.unit[S::N + cell.col], t.unit[2 * S::N + cell.box] };
+        for (const uint16_t* u : units)
+            for (int k = 0; k < S::N; k++) cand[u[k]] &= ~bit;
+    };
+    auto place = [&](int i, int d) {
+        grid[i] = (uint8_t)d;
+        cand[i] = 0;
+        empty--;
+        eliminatePeers(i, 1u << (d - 1));
+    };
+    for (int i = 0; i < S::N2; i++)
+        if (grid[i]) eliminatePeers(i, 1u << (grid[i] - 1));
+
+    while (empty > 0) {
+        bool progress = false;
+
+        // Naked singles: a cell with exactly one candidate
+        for (int i = 0; i < S::N2; i++) {
+            if (grid[i]) continue;
+            uint32_t c = cand[i];
+            if (!c) return finish(false);
+            if (!(c & (c - 1))) {
+                place(i, lowestBit(c) + 1);
+                rep.nakedSingles++;
+                progress = true;
+            }
+        }
+        if (progress) continue;
+
+        // Hidden singles: a digit with exactly one possible cell in a unit
+        for (int u = 0; u < 3 * S::N; u++) {
+            const uint16_t* cells = t.unit[u];
+            uint32_t once = 0, twice = 0, used = 0;
+            for (int k = 0; k < S::N; k++) {
+                int j = cells[k];
+                if (grid[j]) {
+                    used |= 1u << (grid[j] - 1);
+                    continue;
+                }
+                twice |= once & cand[j];
+                once |= cand[j];
+            }
+            if ((once | used) != ALL) return finish(false); // digit with no place left
+
+            uint32_t hidden = once & ~twice;
+            while (hidden) {
+                uint32_t bit = hidden & (0u - hidden);
+                hidden &= hidden - 1;
+
+                int k = 0;
+                while (k < S::N && !(cand[cells[k]] & bit)) k++;
+                if (k == S::N) return finish(false); // its only cell took another hidden single
+                place(cells[k], lowestBit(bit) + 1);
+                rep.hiddenSingles++;
+                progress = true;
+            }
+        }
+        if (progress) continue;
+
+        // Locked candidates, for each box / line intersection (segment):
+        // digits confined to the segment within the box leave the rest of
+        // the line (pointing); digits confined to it within the line leave
+        // the rest of the box (claiming)
+        auto removeFrom = [&](int j, uint32_t bits) {
+            if (cand[j] & bits) {
+                rep.lockedCandidates += bitCount(cand[j] & bits);
+                cand[j] &= ~bits;
+                progress = true;
+            }
+        };
+        for (int box = 0; box < S::N; box++) {
+            const int top = (box / B) * B, left = (box % B) * B;
+            for (int dir = 0; dir < 2; dir++) {        // 0: rows, 1: columns
+                auto at = [&](int line, int k) {        // cell k of the line'th line through the box
+                    return dir == 0 ? (top + line) * S::N + k : k * S::N + left + line;
+                };
+                const int start = dir == 0 ? left : top;
+                for (int line = 0; line < B; line++) {
+                    uint32_t seg = 0, boxRest = 0, lineRest = 0;
+                    for (int l = 0; l < B; l++) {
+                        for (int k = start; k < start + B; k++)
+                            (l == line ? seg : boxRest) |= cand[at(l, k)];
+                    }
+                    for (int k = 0; k < S::N; k++)
+                        if (k < start || k >= start + B) lineRest |= cand[at(line, k)];
+
+                    uint32_t pointing = seg & ~boxRest;
+                    uint32_t claiming = seg & ~lineRest;
+                    for (int k = 0; pointing && k < S::N; k++)
+                        if (k < start || k >= start + B) removeFrom(at(line, k), pointing);
+                    for (int l = 0; claiming && l < B; l++) {
+                        if (l == line) continue;
+                        for (int k = start; k < start + B; k++) removeFrom(at(l, k), claiming);
+                    }
+                }
+            }
+        }
+        if (!progress) break;
+    }
+    rep.solved = empty == 0;
+    return finish(true);
+}
+
+// Logic first, then DLX on what is left; solver.solution() covers the
+// whole grid either way
+template <int B>
+bool solveSudokuWithLogic(BasicSudokuSolver<B>& solver, const BasicGrid<B>& puzzle, LogicReport* report = nullptr) {
+    BasicGrid<B> grid = puzzle;
+    if (!presolveSudoku<B>(grid, report)) {
+        solver.reset();
+        return false;
+    }
+    return solver.solve(grid);
+}
+
+// ----------------- IO and utility helpers -----------------
+
+template <int B = 3>
+bool readSudokuFromStream(istream& in, BasicGrid<B>& grid) {
+    using S = SudokuShape<B>;
+    grid.fill(0);
+
+    for (int i = 0; i < S::N2; ++i) {
+        int x;
+        if (!(in >> x)) {
+            return false;
+        }
+        if (x < 0 || x > S::N) {
+            return false;
+        }
+        grid[i] = (uint8_t)x;
+    }
+    return true;
+}
+
+
+// Pretty-print with . and box lines
+template <int B = 3>
+void printSudokuPretty(const BasicGrid<B>& grid, const string& label) {
+    using S = SudokuShape<B>;
+    const int w = S::N > 9 ? 3 : 2;     // cell width including the space
+
+    string rule;
+    for (int b = 0; b < B; b++) {
+        if (b) rule += '+';
+        rule.append(B * w + (b && b < B - 1 ? 1 : 0), '-');
+    }
+
+    cout << label << ":\n";
+    for (int r = 0; r < S::N; ++r) {
+        if (r != 0 && r % B == 0)
+            cout << rule << '\n';
+        for (int c = 0; c < S::N; ++c) {
+            if (c != 0 && c % B == 0)
+                cout << "| ";
+            int v = grid[r * S::N + c];
+            string cell = v == 0 ? "." : to_string(v);
+            cout << string(w - 1 - cell.size(), ' ') << cell << " ";
+        }
+        cout << '\n';
+    }
+}
+
+// ----------------- Solution verification -----------------
+// A unit is valid when the OR of 1 << digit over its cells is exactly the
+// digits 1..N (bits 1..N): N cells can only cover N bits if all differ.
+// A 0 lands on bit 0 and a digit > N on no bit, so both make the check fail
+// without a branch.
+
+// Check whether a completed grid is a valid Sudoku solution
+template <int B = 3>
+bool checkSudoku(const BasicGrid<B>& grid) {
+    using S = SudokuShape<B>;
+    const uint32_t FULL = ((1u << S::N) - 1) << 1;
+    uint32_t rows[S::N] = {}, cols[S::N] = {}, boxes[S::N] = {};
+
+    for (int i = 0; i < S::N2; ++i) {
+        const auto& cell = sudokuTables<B>.cell[i];
+        unsigned v = grid[i];
+        uint32_t bit = (uint32_t)(v <= (unsigned)S::N) << (v & 31);
+        rows[cell.row] |= bit;
+        cols[cell.col] |= bit;
+        boxes[cell.box] |= bit;
+    }
+
+    uint32_t all = FULL;
+    for (int i = 0; i < S::N; ++i)
+        all &= rows[i] & cols[i] & boxes[i];
+    return all == FULL;
+}
+
+// Batch verifiers for 9x9 grids stored back to back: one SIMD lane per
+// grid, the 27 units taken from bitboardTables. Each kernel handles a
+// prefix of the batch and returns how many grids it did.
+static_assert(sizeof(Grid) == 81, "batch verifiers need Grid packed to 81 bytes");
+
+#if defined(DLSS_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define DLSS_AVX2_VERIFIER 1
+#if defined(__GNUC__)
+#define DLSS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DLSS_TARGET_AVX2
+#endif
+
+// Does this CPU (and OS) support AVX2?
+inline bool cpuHasAvx2() {
+#if defined(__GNUC__)
+    static const bool has = __builtin_cpu_supports("avx2");
+#else
+    static const bool has = [] {
+        int info[4];
+        __cpuidex(info, 0, 0);
+        if (info[0] < 7) return false;
+        __cpuidex(info, 1, 0);
+        bool osSaves = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6; // OSXSAVE, XMM+YMM state
+        __cpuidex(info, 7, 0);
+        return osSaves && (info[1] & (1 << 5)) != 0;
+    }();
+#endif
+    return has;
+}
+
+// 8 grids per step, cells fetched with a 32-bit gather. The gather reads 3
+// bytes past a group's last cell, so the final group is left to the next
+// kernel.
+DLSS_TARGET_AVX2 inline size_t verifyBatchAVX2(const Grid* grids, size_t count, uint8_t* ok) {
+    const uint8_t* base = grids[0].data();
+    const __m256i stride = _mm256_setr_epi32(0, 81, 162, 243, 324, 405, 486, 567);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i low = _mm256_set1_epi32(0xFF);
+    const __m256i full = _mm256_set1_epi32(0x3FE);
+    const BitboardTables& t = bitboardTables;
+
+    size_t g = 0;
+    for (; g + 8 < count; g += 8) {
+        const uint8_t* p = base + g * 81;
+        __m256i bits[81];
+        for (int i = 0; i < 81; i++) {
+            __m256i v = _mm256_i32gather_epi32((const int*)(p + i), stride, 1);
+            bits[i] = _mm256_sllv_epi32(one, _mm256_and_si256(v, low)); // 0 past bit 31
+        }
+
+        __m256i all = full;
+        for (int u = 0; u < 27; u++) {
+            __m256i m = bits[t.unit[u][0]];
+            for (int k = 1; k < 9; k++)
+                m = _mm256_or_si256(m, bits[t.unit[u][k]]);
+            all = _mm256_and_si256(all, m);
+        }
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(all, full)));
+        for (int l = 0; l < 8; l++)
+            ok[g + l] = (uint8_t)((mask >> l) & 1);
+    }
+    return g;
+}
+#endif
+
+#if defined(DLSS_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define DLSS_SSE2_VERIFIER 1
+
+// 4 grids per step. SSE2 has no per-lane shift, so 1 << v is built as the
+// float 2^v (exponent v + 127) and truncated back to an integer; values
+// past 30 come out as 0 or bit 31, never as a valid digit bit.
+inline size_t verifyBatchSSE2(const Grid* grids, size_t count, uint8_t* ok) {
+    const uint8_t* base = grids[0].data();
+    const __m128i bias = _mm_set1_epi32(127);
+    const __m128i full = _mm_set1_epi32(0x3FE);
+    const BitboardTables& t = bitboardTables;
+
+    size_t g = 0;
+    for (; g + 4 <= count; g += 4) {
+        const uint8_t* p = base + g * 81;
+        __m128i bits[81];
+        for (int i = 0; i < 81; i++) {
+            __m128i v = _mm_setr_epi32(p[i], p[81 + i], p[162 + i], p[243 + i]);
+            __m128 pow2 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(v, bias), 23));
+            bits[i] = _mm_cvttps_epi32(pow2);
+        }
+
+        __m128i all = full;
+        for (int u = 0; u < 27; u++) {
+            __m128i m = bits[t.unit[u][0]];
+            for (int k = 1; k < 9; k++)
+                m = _mm_or_si128(m, bits[t.unit[u][k]]);
+            all = _mm_and_si128(all, m);
+        }
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(all, full)));
+        for (int l = 0; l < 4; l++)
+            ok[g + l] = (uint8_t)((mask >> l) & 1);
+    }
+    return g;
+}
+#endif
+
+#if defined(DLSS_NEON)
+#define DLSS_NEON_VERIFIER 1
+
+// 4 grids per step; vshlq_u32 shifts each lane by its own count (0 past 31)
+inline size_t verifyBatchNEON(const Grid* grids, size_t count, uint8_t* ok) {
+    const uint8_t* base = grids[0].data();
+    const uint32x4_t one = vdupq_n_u32(1);
+    const uint32x4_t full = vdupq_n_u32(0x3FE);
+    const BitboardTables& t = bitboardTables;
+
+    size_t g = 0;
+    for (; g + 4 <= count; g += 4) {
+        const uint8_t* p = base + g * 81;
+        uint32x4_t bits[81];
+        for (int i = 0; i < 81; i++) {
+            const int32_t lanes[4] = { p[i], p[81 + i], p[162 + i], p[243 + i] };
+            bits[i] = vshlq_u32(one, vld1q_s32(lanes));
+        }
+
+        uint32x4_t all = full;
+        for (int u = 0; u < 27; u++) {
+            uint32x4_t m = bits[t.unit[u][0]];
+            for (int k = 1; k < 9; k++)
+                m = vorrq_u32(m, bits[t.unit[u][k]]);
+            all = vandq_u32(all, m);
+        }
+        uint32x4_t eq = vceqq_u32(all, full);
+        ok[g + 0] = (uint8_t)(vgetq_lane_u32(eq, 0) & 1);
+        ok[g + 1] = (uint8_t)(vgetq_lane_u32(eq, 1) & 1);
+        ok[g + 2] = (uint8_t)(vgetq_lane_u32(eq, 2) & 1);
+        ok[g + 3] = (uint8_t)(vgetq_lane_u32(eq, 3) & 1);
+    }
+    return g;
+}
+#endif
+
+// Verify count 9x9 grids stored back to back: ok[i] = 1 if grids[i] is a
+// valid solution. Uses the widest kernel this build and CPU support, the
+// scalar checkSudoku for the rest. Returns the number of valid grids.
+size_t verifySudokuBatch(const Grid* grids, size_t count, uint8_t* ok) {
+    size_t done = 0;
+#if defined(DLSS_AVX2_VERIFIER)
+    if (count && cpuHasAvx2()) done = verifyBatchAVX2(grids, count, ok);
+#endif
+#if defined(DLSS_SSE2_VERIFIER)
+    if (count > done) done += verifyBatchSSE2(grids + done, count - done, ok + done);
+#elif defined(DLSS_NEON_VERIFIER)
+    if (count > done) done += verifyBatchNEON(grids + done, count - done, ok + done);
+#endif
+    for (size_t i = done; i < count; i++)
+        ok[i] = checkSudoku(grids[i]);
+
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++) valid += ok[i];
+    return valid;
+}
+
+bool quit(const string& msg) {
+    while (true) {
+        cout << msg;
+        string inp;
+        if (!(cin >> inp)) {
+            return true;
+        }
+        transform(inp.begin(), inp.end(), inp.begin(),
+            [](unsigned char ch) { return std::tolower(ch); });
+
+        if (inp == "y" || inp == "yes") return true;
+        if (inp == "n" || inp == "no")  return false;
+
+        cerr << "ERROR: Not valid input, enter 'y' or 'n'.\n";
+    }
+}
+
+bool isInteger(const string& s, int& value) {
+    try {
+        size_t idx;
+        value = std::stoi(s, &idx);
+        return idx == s.size();
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+int getChoice(const string& msg, const vector<int>& options) {
+    while (true) {
+        cout << msg;
+        string inp;
+        if (!(cin >> inp)) {
+            cerr << "ERROR: Input failure.\n";
+            return options.front();
+        }
+
+        int choice;
+        if (isInteger(inp, choice) &&
+            find(options.begin(), options.end(), choice) != options.end())
+        {
+            return choice;
+        }
+
+        cout << "ERROR: Not a valid choice. Valid options are: ";
+        for (size_t i = 0; i < options.size(); ++i) {
+            cout << options[i];
+            if (i + 1 < options.size()) cout << " or ";
+        }
+        cout << ".\n";
+    }
+}
+
+// ----------------- Compact line format -----------------
+// One puzzle per line: 81 characters, '1'-'9' for clues and '.' or '0' for
+// blanks. Anything after the 81st character (a comma, rating, comment) is
+// ignored as long as it does not continue the grid.
+
+// Read-only view of a whole file: memory-mapped where the platform allows,
+// otherwise read into one buffer
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+#if defined(_WIN32)
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file != INVALID_HANDLE_VALUE) {
+            LARGE_INTEGER len;
+            if (GetFileSizeEx(file, &len) && len.QuadPart > 0) {
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping) {
+                    ptr = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    if (ptr) {
+                        len_ = (size_t)len.QuadPart;
+                        mapped = true;
+                    }
+                }
+            }
+            open = true;
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                    ptr = (const char*)p;
+                    len_ = (size_t)st.st_size;
+                    mapped = true;
+                }
+            }
+            ::close(fd);
+            open = true;
+        }
+#endif
+        if (!ptr && open) {
+            // Empty file, or mapping refused (pipes, special files): plain read
+            ifstream in(path, ios::binary);
+            buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+            ptr = buffer.data();
+            len_ = buffer.size();
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#if defined(_WIN32)
+        if (mapped) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (mapped) munmap((void*)ptr, len_);
+#endif
+    }
+
+    bool isOpen() const { return open; }
+    const char* data() const { return ptr; }
+    size_t size() const { return len_; }
+
+private:
+    const char* ptr = nullptr;
+    size_t len_ = 0;
+    bool open = false;
+    bool mapped = false;
+    vector<char> buffer;   // fallback storage when the file is not mapped
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+// Character -> cell value for the line format (0 = blank, 0xFF = not a cell)
+struct CellCharTable {
+    uint8_t value[256] = {};
+
+    constexpr CellCharTable() {
+        for (int i = 0; i < 256; i++) value[i] = 0xFF;
+        value[(unsigned char)'.'] = 0;
+        for (int d = 0; d <= 9; d++) value['0' + d] = (uint8_t)d;
+    }
+};
+
+constexpr CellCharTable cellChars{};
+
+// Parse one line into 81 flat cells (row-major); false if it is not a puzzle line
+inline bool parseSudokuLine(const char* line, size_t len, uint8_t* cells) {
+    if (len < 81) return false;
+    if (len > 81 && cellChars.value[(unsigned char)line[81]] != 0xFF) return false;
+
+    unsigned bad = 0;
+    for (int i = 0; i < 81; i++) {
+        uint8_t v = cellChars.value[(unsigned char)line[i]];
+        bad |= v >> 4;  // only 0xFF has high bits set
+        cells[i] = v;
+    }
+    return bad == 0;
+}
+
+// Text layout of a buffer, voted on by its first non-blank lines so that
+// one bad line cannot decide it: a line starting with 81 characters that
+// are not spaces or tabs is a line-format entry (valid or not), anything
+// else a grid row. A tie is Unknown.
+enum class TextLayout { Grid, Line, Unknown };
+
+inline TextLayout detectTextLayout(const char* p, size_t size) {
+    const int SAMPLE = 16;      // non-blank lines looked at
+    const char* end = p + size;
+    int line = 0, grid = 0;
+    while (p < end && line + grid < SAMPLE) {
+        const char* eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+        const char* stop = eol ? eol : end;
+        size_t len = (size_t)(stop - p);
+        if (len && p[len - 1] == '\r') len--;
+        if (len) {
+            size_t run = 0;
+            while (run < len && run < 81 && p[run] != ' ' && p[run] != '\t') run++;
+            if (run == 81) line++;
+            else grid++;
+        }
+        p = eol ? eol + 1 : end;
+    }
+    return line > grid ? TextLayout::Line : grid > line ? TextLayout::Grid
+        : line ? TextLayout::Unknown : TextLayout::Grid;
+}
+
+// Sequential puzzle reader over a line-format buffer; blank lines are skipped
+class SudokuLineReader {
+public:
+    SudokuLineReader(const char* data, size_t size) : p(data), end(data + size) {}
+
+    // Next puzzle into cells; returns false at end of input.
+    // valid is false (and cells zeroed) for a malformed line.
+    bool next(uint8_t* cells, bool& valid) {
+        while (p < end) {
+            const char* eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+            const char* stop = eol ? eol : end;
+            const char* line = p;
+            size_t len = (size_t)(stop - line);
+            if (len && line[len - 1] == '\r') len--;
+            p = eol ? eol + 1 : end;
+            lines++;
+            if (len == 0) continue;
+
+            valid = parseSudokuLine(line, len, cells);
+            if (!valid) memset(cells, 0, 81);
+            return true;
+        }
+        return false;
+    }
+
+    // 1-based number of the line last returned
+    size_t lineNumber() const { return lines; }
+
+private:
+    const char* p;
+    const char* end;
+    size_t lines = 0;
+};
+
+// Sequential puzzle reader over the N-lines-of-N-numbers layout. Cells are
+// whitespace-separated and a grid is the next N*N of them, so a bad cell
+// spoils only its own grid and the next one is read from where it starts.
+template <int B = 3>
+class SudokuGridReader {
+public:
+    using S = SudokuShape<B>;
+
+    SudokuGridReader(const char* data, size_t size) : p(data), end(data + size) {}
+
+    // Next puzzle into cells; returns false at end of input. valid is false
+    // (and cells zeroed) if a cell is not a number from 0 to N or the input
+    // ends partway through the grid.
+    bool next(uint8_t* cells, bool& valid) {
+        valid = true;
+        int i = 0;
+        for (; i < S::N2; i++) {
+            while (p < end && isSpace(*p)) {
+                if (*p == '\n') lines++;
+                p++;
+            }
+            if (p == end) break;
+            if (i == 0) first = lines;
+
+            unsigned v = 0;
+            bool number = true;
+            for (; p < end && !isSpace(*p); p++) {
+                unsigned d = (unsigned)(unsigned char)*p - '0';
+                if (d > 9) number = false;
+                else if (v <= (unsigned)S::N) v = v * 10 + d;
+            }
+            if (!number || v > (unsigned)S::N) valid = false;
+            cells[i] = (uint8_t)v;
+        }
+        if (i == 0) return false;
+        partial_ = i < S::N2;
+        if (partial_) valid = false;
+        if (!valid) memset(cells, 0, S::N2);
+        return true;
+    }
+
+    // 1-based line the last grid started on
+    size_t lineNumber() const { return first; }
+    // Did the input end partway through the last grid?
+    bool partial() const { return partial_; }
+
+private:
+    const char* p;
+    const char* end;
+    size_t lines = 1, first = 0;
+    bool partial_ = false;
+
+    static bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+};
+
+// ----------------- Packed binary format -----------------
+// Packed files: an 8-byte header, then one record per grid with 4 bits per
+// cell (cell 2k in the low nibble of byte k, cell 2k+1 in the high nibble).
+// Records have a fixed size, so the index is implicit: record i starts at
+// sizeof(PackedHeader) + i * recordBytes, and the record count is
+// (file size - header) / recordBytes. Puzzles (0 = blank) and solutions use
+// the same layout; a 10M-puzzle corpus is 410 MB against 820 MB as lines.
+struct PackedHeader {
+    char     magic[4];      // "DLSP"
+    uint8_t  version;       // 1
+    uint8_t  side;          // 9
+    uint8_t  recordBytes[2];// little-endian, 41
+
+    static PackedHeader current() {
+        return { { 'D', 'L', 'S', 'P' }, 1, 9, { 41, 0 } };
+    }
+};
+
+const int PACKED_RECORD = 41;
+static_assert(sizeof(PackedHeader) == 8, "PackedHeader must be 8 bytes");
+
+inline void packRecord(const Grid& grid, uint8_t* p) {
+    for (int k = 0; k < 40; k++)
+        p[k] = (uint8_t)((grid[2 * k] & 0xF) | (grid[2 * k + 1] << 4));
+    p[40] = (uint8_t)(grid[80] & 0xF);
+}
+
+// Packed byte -> its two cells, and whether either is above 9
+struct PackedByteTable {
+    uint8_t cells[256][2] = {};
+    uint8_t bad[256] = {};
+
+    constexpr PackedByteTable() {
+        for (int b = 0; b < 256; b++) {
+            cells[b][0] = (uint8_t)(b & 0xF);
+            cells[b][1] = (uint8_t)(b >> 4);
+            bad[b] = (uint8_t)((b & 0xF) > 9 || (b >> 4) > 9);
+        }
+    }
+};
+
+constexpr PackedByteTable packedBytes{};
+
+// False (grid zeroed) if a cell holds a nibble above 9
+inline bool unpackRecord(const uint8_t* p, Grid& grid) {
+    unsigned bad = 0;
+    for (int k = 0; k < 40; k++) {
+        memcpy(&grid[2 * k], packedBytes.cells[p[k]], 2);
+        bad |= packedBytes.bad[p[k]];
+    }
+    grid[80] = p[40] & 0xF;
+    bad |= (unsigned)(p[40] > 9);
+    if (bad) grid = Grid{};
+    return !bad;
+}
+
+// Does the buffer start with a packed header (any version)?
+inline bool looksLikePacked(const char* p, size_t size) {
+    return size >= sizeof(PackedHeader) && memcmp(p, "DLSP", 4) == 0;
+}
+
+// Random-access view of a packed buffer (usually a MappedFile); records are
+// decoded straight from the buffer, nothing is copied up front
+class PackedCorpus {
+public:
+    PackedCorpus(const char* data, size_t size) : base((const uint8_t*)data) {
+        PackedHeader h;
+        if (!looksLikePacked(data, size)) return;
+        memcpy(&h, data, sizeof h);
+        const PackedHeader want = PackedHeader::current();
+        if (h.version != want.version || h.side != want.side ||
+            h.recordBytes[0] != want.recordBytes[0] || h.recordBytes[1] != want.recordBytes[1])
+            return;
+        size_t body = size - sizeof h;
+        records = body / PACKED_RECORD;
+        trailing = body % PACKED_RECORD;
+        valid = true;
+    }
+
+    // Header present and of a version / layout this build reads
+    bool ok() const { return valid; }
+    size_t size() const { return records; }
+    // Bytes after the last whole record (a truncated file)
+    size_t trailingBytes() const { return trailing; }
+
+    bool decode(size_t i, Grid& grid) const {
+        return unpackRecord(base + sizeof(PackedHeader) + i * PACKED_RECORD, grid);
+    }
+
+private:
+    const uint8_t* base;
+    size_t records = 0, trailing = 0;
+    bool valid = false;
+};
+
+// Sequential puzzles from a buffer in any of the three input layouts,
+// detected from its start (packed header, else detectTextLayout): packed,
+// 81-character lines, or 9 lines of 9 numbers per grid
+class PuzzleSource {
+public:
+    enum class Layout { Grid, Line, Packed };
+
+    PuzzleSource(const char* data, size_t size)
+        : layout_(Layout::Packed), lines(data, size), grids(data, size), packed(data, size) {
+        if (looksLikePacked(data, size)) return;
+        TextLayout text = detectTextLayout(data, size);
+        ambiguous = text == TextLayout::Unknown;
+        layout_ = text == TextLayout::Line ? Layout::Line : Layout::Grid;
+    }
+
+    Layout layout() const { return layout_; }
+
+    // Why the puzzles cannot be read, completing "<file> ...", or null:
+    // text with no clear layout, or a packed file of an unknown version or
+    // cut off mid-record
+    const char* error() const {
+        if (ambiguous) return "is half 81-character puzzle lines and half grid rows; cannot tell its layout";
+        if (layout_ != Layout::Packed) return nullptr;
+        if (!packed.ok()) return "is packed in a version or layout this build cannot read";
+        if (packed.trailingBytes()) return "ends in a partial record (truncated packed file)";
+        return nullptr;
+    }
+    bool ok() const { return error() == nullptr; }
+    const PackedCorpus& packedCorpus() const { return packed; }
+
+    // Next puzzle; false at end of input. valid is false (grid zeroed) for
+    // a malformed line or record, which still counts as a puzzle.
+    bool next(Grid& grid, bool& valid) {
+        valid = true;
+        switch (layout_) {
+        case Layout::Packed:
+            if (!packed.ok() || record == packed.size()) return false;
+            valid = packed.decode(record++, grid);
+            return true;
+        case Layout::Line:
+            return lines.next(grid.data(), valid);
+        default:
+            return grids.next(grid.data(), valid);
+        }
+    }
+
+    // Where the last puzzle came from, for messages: "Line 12", "Record 3",
+    // "Grid at line 19"
+    string position() const {
+        switch (layout_) {
+        case Layout::Packed: return "Record " + to_string(record);
+        case Layout::Line:   return "Line " + to_string(lines.lineNumber());
+        default:
+            return "Grid at line " + to_string(grids.lineNumber())
+                + (grids.partial() ? " (cut short by the end of the file)" : "");
+        }
+    }
+
+private:
+    Layout layout_;
+    bool ambiguous = false;     // text layout could not be told
+    SudokuLineReader lines;
+    SudokuGridReader<3> grids;
+    PackedCorpus packed;
+    size_t record = 0;
+};
+
+// Load every puzzle of a file in any input layout. Malformed lines or
+// records come through as blank grids. False if the file cannot be opened
+// or read (PuzzleSource::error).
+bool loadPuzzleFile(const string& path, vector<Grid>& puzzles) {
+    MappedFile file(path);
+    if (!file.isOpen()) return false;
+
+    PuzzleSource source(file.data(), file.size());
+    if (!source.ok()) return false;
+    if (source.layout() == PuzzleSource::Layout::Packed)
+        puzzles.reserve(puzzles.size() + source.packedCorpus().size());
+
+    Grid grid{};
+    bool valid;
+    while (source.next(grid, valid))
+        puzzles.push_back(grid);
+    return true;
+}
+
+// ----------------- Work-stealing thread pool -----------------
+// Each worker owns a task deque. It pops its own work from the back and,
+// when that runs dry, steals from the front of the other workers' deques.
+// Tasks receive their worker index so they can use per-thread state.
+class WorkStealingPool {
+public:
+    using Task = function<void(int worker)>;
+
+    // threads <= 0 uses one worker per hardware thread
+    explicit WorkStealingPool(int threads = 0) {
+        if (threads <= 0) threads = (int)thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+
+        for (int i = 0; i < threads; i++)
+            queues.emplace_back(new Queue());
+        for (int i = 0; i < threads; i++)
+            workers.emplace_back([this, i] { run(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> lk(stateMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    int size() const { return (int)workers.size(); }
+
+    // Queue a task; tasks submitted from a worker go to that worker's own deque
+    void submit(Task task) {
+        int target = currentWorker >= 0 && currentPool == this
+            ? currentWorker
+            : (int)(nextQueue++ % queues.size());
+
+        pending++;
+        {
+            lock_guard<mutex> lk(stateMutex);
+            queued++;
+        }
+        {
+            lock_guard<mutex> lk(queues[target]->m);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // Block until every submitted task has finished (call from outside the pool).
+    // Rethrows the first exception a task threw.
+    void wait() {
+        unique_lock<mutex> lk(stateMutex);
+        idle.wait(lk, [this] { return pending == 0; });
+        if (failure) {
+            exception_ptr e = failure;
+            failure = nullptr;
+            rethrow_exception(e);
+        }
+    }
+
+private:
+    struct Queue {
+        mutex m;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> workers;
+    mutex stateMutex;
+    condition_variable wake, idle;
+    atomic<long> queued{ 0 };       // tasks sitting in some deque
+    atomic<long> pending{ 0 };      // tasks submitted but not finished
+    atomic<unsigned> nextQueue{ 0 };
+    bool stopping = false;
+    exception_ptr failure;
+
+    static thread_local int currentWorker;
+    static thread_local const WorkStealingPool* currentPool;
+
+    // Own deque from the back, then other deques from the front
+    bool tryPop(int self, Task& task) {
+        int n = (int)queues.size();
+        for (int k = 0; k < n; k++) {
+            Queue& q = *queues[(self + k) % n];
+            lock_guard<mutex> lk(q.m);
+            if (q.tasks.empty()) continue;
+            if (k == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void run(int self) {
+        currentWorker = self;
+        currentPool = this;
+
+        while (true) {
+            Task task;
+            if (tryPop(self, task)) {
+                try {
+                    task(self);
+                }
+                catch (...) {
+                    lock_guard<mutex> lk(stateMutex);
+                    if (!failure) failure = current_exception();
+                }
+                if (pending.fetch_sub(1) == 1) {
+                    lock_guard<mutex> lk(stateMutex);
+                    idle.notify_all();
+                }
+                continue;
+            }
+
+            unique_lock<mutex> lk(stateMutex);
+            wake.wait(lk, [this] { return stopping || queued > 0; });
+            if (stopping && queued <= 0) return;
+        }
+    }
+};
+
+thread_local int WorkStealingPool::currentWorker = -1;
+thread_local const WorkStealingPool* WorkStealingPool::currentPool = nullptr;
+
+// ----------------- Parallel DLX search -----------------
+// The first few branch levels are expanded up front; every resulting prefix
+// (a list of row handles) becomes a pool task that restores a private copy
+// of the matrix, replays the prefix and searches that subtree. Arena handles
+// are indices, so they mean the same row in every copy.
+
+// Collect the row prefixes of the first `depth` branch levels. Dead ends are
+// dropped; the matrix is left as it was.
+template <class Matrix, class Handle>
+void splitBranches(Matrix& m, int depth, vector<Handle>& prefix, vector<vector<Handle>>& out) {
+    const Handle head = m.root();
+    if (depth == 0 || m.R(head) == head) { // leaf, or already a solution
+        out.push_back(prefix);
+        return;
+    }
+    Handle c = m.chooseColumn();
+    if (m.size(c) == 0) return;
+
+    m.cover(c);
+    for (Handle r = m.D(c); r != c; r = m.D(r)) {
+        for (Handle j = m.R(r); j != r; j = m.R(j))
+            m.cover(m.C(j));
+        prefix.push_back(r);
+        splitBranches(m, depth - 1, prefix, out);
+        prefix.pop_back();
+        for (Handle j = m.L(r); j != r; j = m.L(j))
+            m.uncover(m.C(j));
+    }
+    m.uncover(c);
+}
+
+// Find one solution using every worker of pool, splitting the tree at the
+// first splitDepth levels. The first subtree to reach a solution raises a
+// shared flag; the others check it every SLICE nodes and stop. On success
+// the solution rows are appended to matrix.solution like search() would,
+// but the search is not left parked and the links are untouched.
+template <class Index>
+bool parallelSearch(ArenaDLX<Index>& matrix, WorkStealingPool& pool, int splitDepth = 2) {
+    const uint64_t SLICE = 4096;     // nodes between checks of the stop flag
+
+    matrix.abandonSearch();
+    vector<Index> prefix;
+    vector<vector<Index>> branches;
+    splitBranches(matrix, splitDepth, prefix, branches);
+    if (branches.empty()) return false;
+
+    atomic<bool> stop{ false };
+    vector<int> winner;
+    vector<unique_ptr<ArenaDLX<Index>>> copies(pool.size()); // one per worker, reused
+
+    for (const auto& branch : branches) {
+        pool.submit([&, branch](int w) {
+            if (stop.load(memory_order_relaxed)) return;
+            if (!copies[w]) copies[w].reset(new ArenaDLX<Index>(matrix));
+            ArenaDLX<Index>& local = *copies[w];
+            local.restore(matrix);
+            local.solution = matrix.solution;
+
+            for (Index r : branch) {
+                local.solution.push_back(local.rowID(r));
+                local.coverRow(r);
+            }
+
+            local.beginSearch();
+            while (!stop.load(memory_order_relaxed)) {
+                SearchStatus st = local.resume(SLICE);
+                if (st == SearchStatus::Exhausted) break;
+                if (st == SearchStatus::Found) {
+                    if (!stop.exchange(true)) winner = local.solution;
+                    break;
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    if (!stop) return false;
+    matrix.solution = std::move(winner);
+    return true;
+}
+
+// Sudoku front end: same as solver.solve(puzzle), searched on the pool
+template <int B>
+bool solveSudokuParallel(BasicSudokuSolver<B>& solver, const BasicGrid<B>& puzzle,
+                         WorkStealingPool& pool, int splitDepth = 2) {
+    solver.reset();
+    return applyInitialSudoku<B>(solver.dlx, puzzle) && parallelSearch(solver.dlx, pool, splitDepth);
+}
+
+// ----------------- Canonical form and solution cache -----------------
+// Puzzles that differ only by a validity-preserving transform (transposition,
+// band / stack order, row order within a band, column order within a
+// stack, digit relabeling) share one solution up to that transform.
+// CanonicalPuzzle picks a representative by a cheap heuristic: order bands,
+// rows, stacks and columns by transform-invariant keys (clue counts refined
+// by where the clues sit and how common their digits are), relabel digits
+// by first appearance, and keep the smaller of the two orientations. Ties
+// are broken by position, so two equivalent puzzles can still canonicalize
+// differently (a cache miss, never a wrong answer); the mapping back to the
+// caller's grid is exact.
+
+class CanonicalPuzzle {
+public:
+    Grid     grid;      // canonical puzzle
+    uint64_t hash;      // of grid, never 0
+
+    explicit CanonicalPuzzle(const Grid& puzzle) {
+        Grid transposed;
+        for (int r = 0; r < 9; r++)
+            for (int c = 0; c < 9; c++)
+                transposed[c * 9 + r] = puzzle[r * 9 + c];
+
+        Orientation a, b;
+        orient(puzzle, a);
+        orient(transposed, b);
+        const bool useTransposed = b.grid < a.grid;
+        const Orientation& o = useTransposed ? b : a;
+
+        grid = o.grid;
+        for (int i = 0; i < 10; i++) {
+            toDigit[i] = o.digitMap[i];
+            fromDigit[o.digitMap[i]] = (uint8_t)i;
+        }
+        for (int k = 0; k < 81; k++) {
+            int src = o.cellFrom[k];
+            source[k] = useTransposed ? (uint8_t)((src % 9) * 9 + src / 9) : (uint8_t)src;
+        }
+
+        uint64_t words[6];
+        pack(grid, words);
+        uint64_t h = 0x9E3779B97F4A7C15ull;
+        for (uint64_t w : words) {
+            h ^= w;
+            h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+            h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+            h ^= h >> 31;
+        }
+        hash = h ? h : 1;
+    }
+
+    // A grid in the caller's frame -> canonical frame, and back
+    Grid toCanonical(const Grid& g) const {
+        Grid out;
+        for (int k = 0; k < 81; k++) out[k] = toDigit[g[source[k]]];
+        return out;
+    }
+
+    Grid fromCanonical(const Grid& g) const {
+        Grid out;
+        for (int k = 0; k < 81; k++) out[source[k]] = fromDigit[g[k]];
+        return out;
+    }
+
+    // Is solution a valid completion of the canonical puzzle?
+    bool solves(const Grid& solution) const {
+        unsigned differ = 0;
+        for (int k = 0; k < 81; k++)
+            differ |= (unsigned)(grid[k] && grid[k] != solution[k]);
+        return !differ && checkSudoku(solution);
+    }
+
+    // 81 cells <-> 6 words of 16 nibbles
+    static void pack(const Grid& g, uint64_t words[6]) {
+        for (int w = 0; w < 6; w++) words[w] = 0;
+        for (int k = 0; k < 81; k++)
+            words[k >> 4] |= (uint64_t)(g[k] & 0xF) << ((k & 15) * 4);
+    }
+
+    static Grid unpack(const uint64_t words[6]) {
+        Grid g;
+        for (int k = 0; k < 81; k++)
+            g[k] = (uint8_t)((words[k >> 4] >> ((k & 15) * 4)) & 0xF);
+        return g;
+    }
+
+private:
+    uint8_t source[81];     // canonical cell k comes from caller cell source[k]
+    uint8_t toDigit[10];    // caller digit -> canonical digit (0 stays 0)
+    uint8_t fromDigit[10];
+
+    struct Orientation {
+        Grid    grid;
+        uint8_t cellFrom[81];
+        uint8_t digitMap[10];
+    };
+
+    static uint64_t mix(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    static void orient(const Grid& g, Orientation& o) {
+        // Keys that no row / column permutation or relabeling can change:
+        // start from clue counts, then refine each row key by the keys of
+        // the columns its clues sit in (and vice versa), with each clue
+        // weighted by how often its digit occurs. Sums keep them order-free.
+        int digitCount[10] = {};
+        for (int k = 0; k < 81; k++) digitCount[g[k]]++;
+
+        uint64_t rowKey[9] = {}, colKey[9] = {};
+        for (int k = 0; k < 81; k++) {
+            if (!g[k]) continue;
+            rowKey[k / 9]++;
+            colKey[k % 9]++;
+        }
+        for (int round = 0; round < 2; round++) {
+            uint64_t nextRow[9], nextCol[9];
+            for (int i = 0; i < 9; i++) {
+                nextRow[i] = mix(rowKey[i]);
+                nextCol[i] = mix(colKey[i]);
+            }
+            for (int k = 0; k < 81; k++) {
+                if (!g[k]) continue;
+                uint64_t weight = (uint64_t)digitCount[g[k]] << 32;
+                nextRow[k / 9] += mix(colKey[k % 9] ^ weight);
+                nextCol[k % 9] += mix(rowKey[k / 9] ^ weight);
+            }
+            for (int i = 0; i < 9; i++) {
+                rowKey[i] = nextRow[i];
+                colKey[i] = nextCol[i];
+            }
+        }
+
+        // Lines within a band / stack by key, bands / stacks by key sum;
+        // ties keep their position
+        auto order = [](const uint64_t key[9], uint8_t out[9]) {
+            uint64_t groupKey[3] = {};
+            for (int i = 0; i < 9; i++) groupKey[i / 3] += key[i];
+            uint8_t groups[3] = { 0, 1, 2 };
+            stable_sort(groups, groups + 3, [&](int x, int y) { return groupKey[x] > groupKey[y]; });
+            for (int gi = 0; gi < 3; gi++) {
+                uint8_t* lines = out + 3 * gi;
+                for (int j = 0; j < 3; j++) lines[j] = (uint8_t)(3 * groups[gi] + j);
+                stable_sort(lines, lines + 3, [&](int x, int y) { return key[x] > key[y]; });
+            }
+        };
+        uint8_t rowOrder[9], colOrder[9];
+        order(rowKey, rowOrder);
+        order(colKey, colOrder);
+
+        // Apply, then relabel digits by first appearance (absent digits last)
+        for (int d = 0; d < 10; d++) o.digitMap[d] = 0;
+        uint8_t next = 1;
+        for (int i = 0; i < 9; i++) {
+            int r = rowOrder[i];
+            for (int j = 0; j < 9; j++) {
+                int src = r * 9 + colOrder[j];
+                o.cellFrom[i * 9 + j] = (uint8_t)src;
+                uint8_t d = g[src];
+                if (d && !o.digitMap[d]) o.digitMap[d] = next++;
+                o.grid[i * 9 + j] = o.digitMap[d];
+            }
+        }
+        for (int d = 1; d <= 9; d++)
+            if (!o.digitMap[d]) o.digitMap[d] = next++;
+    }
+};
+
+// Concurrent cache from canonical puzzle to canonical solution with a fixed
+// memory budget. Lock-free: each slot is a seqlock over atomic words, so a
+// reader never blocks and a writer that finds its slot busy skips the
+// insert. Sets of WAYS slots; a full set evicts one random way.
+// Only the 64-bit puzzle hash is stored as the key; a hit is accepted only
+// if the stored solution really solves the canonical puzzle, so a hash
+// collision costs a miss, not a wrong answer.
+class SolutionCache {
+public:
+    static const int WAYS = 4;
+
+    // Largest power-of-two number of sets that fits in bytes
+    explicit SolutionCache(size_t bytes) {
+        size_t sets = 1;
+        while (sets * 2 * WAYS * sizeof(Slot) <= bytes) sets *= 2;
+        slots = vector<Slot>(sets * WAYS);
+        setMask = sets - 1;
+    }
+
+    SolutionCache(const SolutionCache&) = delete;
+    SolutionCache& operator=(const SolutionCache&) = delete;
+
+    size_t capacity() const { return slots.size(); }
+
+    // Solution of key's puzzle, in the caller's frame, if cached
+    bool lookup(const CanonicalPuzzle& key, Grid& solution) const {
+        const Slot* set = &slots[(key.hash & setMask) * WAYS];
+        for (int w = 0; w < WAYS; w++) {
+            const Slot& s = set[w];
+            uint64_t before = s.seq.load(memory_order_acquire);
+            if ((before & 1) || s.tag.load(memory_order_relaxed) != key.hash) continue;
+
+            uint64_t words[6];
+            for (int i = 0; i < 6; i++) words[i] = s.words[i].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (s.seq.load(memory_order_relaxed) != before) continue; // torn read
+
+            Grid canon = CanonicalPuzzle::unpack(words);
+            if (!key.solves(canon)) continue;
+            solution = key.fromCanonical(canon);
+            return true;
+        }
+        return false;
+    }
+
+    // Remember solution (caller's frame) for key's puzzle
+    void insert(const CanonicalPuzzle& key, const Grid& solution) {
+        Slot* set = &slots[(key.hash & setMask) * WAYS];
+        int victim = -1;
+        for (int w = 0; w < WAYS && victim < 0; w++)
+            if (set[w].tag.load(memory_order_relaxed) == key.hash) victim = w;
+        for (int w = 0; w < WAYS && victim < 0; w++)
+            if (set[w].tag.load(memory_order_relaxed) == 0) victim = w;
+        if (victim < 0) {
+            static thread_local uint32_t rng = 0x9E3779B9u;
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;   // xorshift32
+            victim = (int)(rng % WAYS);
+        }
+
+        uint64_t words[6];
+        CanonicalPuzzle::pack(key.toCanonical(solution), words);
+
+        Slot& s = set[victim];
+        uint64_t seq = s.seq.load(memory_order_relaxed);
+        if ((seq & 1) || !s.seq.compare_exchange_strong(seq, seq + 1, memory_order_acquire))
+            return; // another thread is writing this slot
+        // The odd seq must be visible before any new data: without the
+        // fence a reader could see new words under the old even seq and
+        // accept a torn slot. The final release store orders the data
+        // before the even seq.
+        atomic_thread_fence(memory_order_release);
+        s.tag.store(key.hash, memory_order_relaxed);
+        for (int i = 0; i < 6; i++) s.words[i].store(words[i], memory_order_relaxed);
+        s.seq.store(seq + 2, memory_order_release);
+    }
+
+private:
+    struct Slot {                       // 64 bytes
+        atomic<uint64_t> seq{ 0 };      // odd while a writer owns the slot
+        atomic<uint64_t> tag{ 0 };      // canonical puzzle hash, 0 = empty
+        atomic<uint64_t> words[6];      // canonical solution, 4 bits per cell
+
+        Slot() {
+            for (auto& w : words) w.store(0, memory_order_relaxed);
+        }
+    };
+
+    vector<Slot> slots;
+    size_t setMask = 0;
+};
+
+// ----------------- Buffered solution output -----------------
+// printSudokuPretty is for the interactive menu only; batch output goes
+// through SolutionWriter, which formats straight into one preallocated
+// buffer and hands it to the stream in large writes.
+
+enum class OutputFormat {
+    Auto,   // same layout as the input
+    Grid,   // 9 lines of 9 numbers, blank line after each grid
+    Line,   // one 81-character line per grid, '.' for blanks
+    Packed  // PackedHeader, then PACKED_RECORD bytes per grid
+};
+
+class SolutionWriter {
+public:
+    static const size_t DEFAULT_BUFFER = 1 << 20;
+
+    SolutionWriter(ostream& out, OutputFormat format, size_t bufferBytes = DEFAULT_BUFFER)
+        : out(out), format(format), buf(max(bufferBytes, (size_t)4096)) {
+        if (format == OutputFormat::Packed) {
+            const PackedHeader h = PackedHeader::current();
+            memcpy(room(sizeof h), &h, sizeof h);
+        }
+    }
+
+    SolutionWriter(const SolutionWriter&) = delete;
+    SolutionWriter& operator=(const SolutionWriter&) = delete;
+
+    ~SolutionWriter() { flush(); }
+
+    void write(const Grid& grid) {
+        switch (format) {
+        case OutputFormat::Packed:
+            packRecord(grid, (uint8_t*)room(PACKED_RECORD));
+            break;
+        case OutputFormat::Line: {
+            char* p = room(82);
+            for (int i = 0; i < 81; i++)
+                p[i] = cellChar(grid[i]);
+            p[81] = '\n';
+            break;
+        }
+        default: {
+            char* p = room(9 * 18 + 1);
+            for (int r = 0; r < 9; r++, p += 18) {
+                for (int c = 0; c < 9; c++) {
+                    p[2 * c] = (char)('0' + grid[r * 9 + c]);
+                    p[2 * c + 1] = ' ';
+                }
+                p[17] = '\n';
+            }
+            *p = '\n';
+            break;
+        }
+        }
+        count++;
+    }
+
+    // Hand the buffered bytes to the stream
+    void flush() {
+        if (used) out.write(buf.data(), (streamsize)used);
+        used = 0;
+    }
+
+    // Grids written so far
+    size_t written() const { return count; }
+
+private:
+    ostream& out;
+    OutputFormat format;
+    vector<char> buf;
+    size_t used = 0;
+    size_t count = 0;
+
+    // Reserve n bytes at the end of the buffer, flushing first if full
+    char* room(size_t n) {
+        if (used + n > buf.size()) flush();
+        char* p = buf.data() + used;
+        used += n;
+        return p;
+    }
+
+    static char cellChar(uint8_t v) {
+        return v == 0 ? '.' : (char)('0' + v);
+    }
+};
+
+const size_t SolutionWriter::DEFAULT_BUFFER;
+
+// Where a command-line mode writes: the --out file (opened into file) or
+// stdout. Packed output is binary, so it needs a file. Null after an error
+// has been reported.
+ostream* openOutput(const string& path, OutputFormat format, ofstream& file) {
+    if (format == OutputFormat::Packed && path.empty()) {
+        cerr << "ERROR: --format packed needs --out.\n";
+        return nullptr;
+    }
+    if (path.empty()) return &cout;
+    file.open(path, ios::binary);
+    if (!file) {
+        cerr << "ERROR: Could not open output file " << path << ".\n";
+        return nullptr;
+    }
+    return &file;
+}
+
+// ----------------- Batch solving -----------------
+
+enum class SudokuEngine { DLX, Bitboard, Gpu };
+
+// ----------------- GPU batch backend -----------------
+// --engine gpu hands each block to cudaSolveBatch (DLSS_cuda.cu), one
+// puzzle per GPU thread. Puzzles the GPU gives up on, and whole runs on a
+// build without DLSS_WITH_CUDA or a machine without a device, go to the CPU
+// bitboard engine instead.
+
+const uint32_t GPU_MAX_STEPS = 20000;  // per-puzzle search steps before the CPU takes over
+
+// Solve puzzles on the GPU into solutions, one GpuStatus per puzzle in
+// status. Puzzles that are not valid (malformed or conflicting clues) come
+// back blank as GPU_NO_SOLUTION, whatever the kernel made of them.
+// False (with a message on cerr) if the GPU cannot be used.
+bool gpuSolveBlock(const vector<Grid>& puzzles, const vector<char>& valid,
+                   vector<Grid>& solutions, vector<uint8_t>& status) {
+    status.assign(puzzles.size(), GPU_GAVE_UP);
+#if defined(DLSS_WITH_CUDA)
+    char error[256] = "";
+    if (cudaSolveBatch(puzzles[0].data(), puzzles.size(), solutions[0].data(), status.data(),
+                       GPU_MAX_STEPS, error, sizeof error)) {
+        for (size_t i = 0; i < puzzles.size(); i++) {
+            if (valid[i]) continue;
+            solutions[i] = Grid{};
+            status[i] = GPU_NO_SOLUTION;
+        }
+        return true;
+    }
+    cerr << "ERROR: GPU batch failed (" << error << "); solving on the CPU instead.\n";
+#else
+    (void)valid;
+    (void)solutions;
+    cerr << "ERROR: Built without DLSS_WITH_CUDA; --engine gpu solves on the CPU instead.\n";
+#endif
+    return false;
+}
+
+struct BatchOptions {
+    string input;                           // puzzle file: 81-char lines or 9 lines of 9 numbers
+    string output;                          // solutions file, empty = stdout
+    int threads = 0;                        // 0 = one per hardware thread
+    SudokuEngine engine = SudokuEngine::DLX;
+    string statsPath;                       // per-puzzle DLX search counters (CSV), empty = off
+    int size = 9;                           // grid side: 4, 9, 16 or 25
+    uint64_t maxNodes = 0;                  // per-puzzle DLX node budget, 0 = none
+    double timeoutMs = 0;                   // per-puzzle DLX time budget, 0 = none
+    size_t cacheBytes = 0;                  // solution cache shared by the workers, 0 = off
+    bool presolve = false;                  // logical techniques before the search
+    bool symmetry = false;                  // --count: break the digit symmetry
+    uint64_t countLimit = 0;                // --count: stop counting a puzzle here, 0 = none
+
+    OutputFormat format = OutputFormat::Auto;
+
+    bool budgeted() const { return maxNodes > 0 || timeoutMs > 0; }
+};
+
+// Per-thread solver state, reused for every puzzle the worker handles
+struct BatchWorker {
+    SudokuSolver   dlx;
+    BitboardSolver bitboard;
+
+    // stats (DLX engine only) receives the search counters when non-null
+    bool solve(SudokuEngine engine, const Grid& puzzle, Grid& out, SearchStats* stats = nullptr) {
+        bool ok;
+        if (engine == SudokuEngine::Bitboard) ok = bitboard.solve(puzzle);
+        else if (stats)                       ok = dlx.solve(puzzle, *stats);
+        else                                  ok = dlx.solve(puzzle);
+        if (!ok) return false;
+
+        out = extractSolution(engine == SudokuEngine::DLX ? dlx.solution() : bitboard.solution());
+        return true;
+    }
+
+    // DLX solve within opt's per-puzzle budget
+    SearchStatus solveWithin(const BatchOptions& opt, const Grid& puzzle, Grid& out, SearchStats* stats = nullptr) {
+        SearchBudget budget;
+        if (opt.maxNodes) budget.maxNodes = opt.maxNodes;
+        if (opt.timeoutMs > 0) budget.setTimeout(opt.timeoutMs);
+
+        SearchStatus status = stats ? dlx.solveWithin(puzzle, budget, *stats) : dlx.solveWithin(puzzle, budget);
+        if (status == SearchStatus::Found) out = extractSolution(dlx.solution());
+        return status;
+    }
+};
+
+// Write a grid in the N-lines-of-N-numbers layout
+template <int B = 3>
+void writeSudoku(ostream& out, const BasicGrid<B>& grid) {
+    using S = SudokuShape<B>;
+    for (int i = 0; i < S::N2; ++i) {
+        out << (int)grid[i] << (i % S::N == S::N - 1 ? '\n' : ' ');
+    }
+    out << '\n';
+}
+
+// One CSV line of search counters for puzzle index
+void appendStatsCsv(string& buf, size_t index, bool solved, const SearchStats& st) {
+    buf += to_string(index);
+    buf += solved ? ",1" : ",0";
+    const uint64_t fields[] = { st.nodes, st.covers, st.uncovers, st.updates, st.backtracks };
+    for (uint64_t f : fields) {
+        buf += ',';
+        buf += to_string(f);
+    }
+    buf += ',';
+    buf += to_string(st.maxDepth);
+    for (uint64_t b : st.branching) {
+        buf += ',';
+        buf += to_string(b);
+    }
+    buf += '\n';
+}
 
-        // Insert at bottom of column c (before c)
-        n->D = c;
-        n->U = c->U;
-        c->U->D = n;
-        c->U = n;
+// Solve every puzzle in the input file across a work-stealing pool and
+// write the solutions in input order, in the input's format (unsolvable or
+// malformed puzzles come out as blank grids).
+// Blocks are double-buffered: the next block is read and the previous one
+// written while the workers solve the current one.
+int runBatch(const BatchOptions& opt) {
+    const size_t BLOCK = 16384;  // puzzles per block
+    const size_t CHUNK = 64;     // puzzles per task
 
-        n->C = c;
-        c->size++;
-        n->rowID = rowID;
-        return n;
+    MappedFile file(opt.input);
+    if (!file.isOpen()) {
+        cerr << "ERROR: Could not open file " << opt.input << ".\n";
+        return 1;
     }
+    // Every layout decodes straight out of the mapped file
+    PuzzleSource source(file.data(), file.size());
+    if (const char* why = source.error()) {
+        cerr << "ERROR: " << opt.input << " " << why << ".\n";
+        return 1;
+    }
+    const PuzzleSource::Layout layout = source.layout();
 
-    // Make a circular doubly-linked row from the given nodes
-    static void linkRow(const std::vector<Node*>& row) {
-        if (row.empty()) return;
-        int n = (int)row.size();
-        for (int i = 0; i < n; i++) {
-            Node* a = row[i];
-            Node* b = row[(i + 1) % n];
-            a->R = b;
-            b->L = a;
-        }
+    // Auto keeps the input layout; packed output needs a file, so packed
+    // input written to stdout comes out as lines
+    OutputFormat format = opt.format;
+    if (format == OutputFormat::Auto) {
+        format = layout == PuzzleSource::Layout::Grid ? OutputFormat::Grid
+            : layout == PuzzleSource::Layout::Packed && !opt.output.empty() ? OutputFormat::Packed
+            : OutputFormat::Line;
     }
 
-    // Standard DLX cover / uncover
+    if (opt.budgeted() && opt.engine != SudokuEngine::DLX) {
+        cerr << "ERROR: --max-nodes and --timeout need the dlx engine.\n";
+        return 1;
+    }
+    // The GPU solves a whole block before the CPU paths run, so neither
+    // would ever see the puzzles it solved
+    if (opt.engine == SudokuEngine::Gpu && (opt.cacheBytes || opt.presolve)) {
+        cerr << "ERROR: --cache and --presolve do not work with the gpu engine.\n";
+        return 1;
+    }
 
-    static void cover(Column* c) {
-        c->R->L = c->L;
-        c->L->R = c->R;
+    ofstream fout;
+    ostream* dest = openOutput(opt.output, format, fout);
+    if (!dest) return 1;
+    ostream& out = *dest;
 
-        for (Node* row = c->D; row != c; row = row->D) {
-            for (Node* node = row->R; node != row; node = node->R) {
-                node->D->U = node->U;
-                node->U->D = node->D;
-                node->C->size--;
-            }
+    const bool wantStats = !opt.statsPath.empty();
+    ofstream statsOut;
+    if (wantStats) {
+        if (opt.engine != SudokuEngine::DLX) {
+            cerr << "ERROR: --stats needs the dlx engine.\n";
+            return 1;
+        }
+        statsOut.open(opt.statsPath, ios::binary);
+        if (!statsOut) {
+            cerr << "ERROR: Could not open stats file " << opt.statsPath << ".\n";
+            return 1;
         }
+        statsOut << "puzzle,solved,nodes,covers,uncovers,updates,backtracks,max_depth";
+        for (int i = 0; i < SearchStats::BRANCH_BUCKETS; i++)
+            statsOut << ",branch_" << i << (i == SearchStats::BRANCH_BUCKETS - 1 ? "+" : "");
+        statsOut << '\n';
     }
 
-    static void uncover(Column* c) {
-        for (Node* row = c->U; row != c; row = row->U) {
-            for (Node* node = row->L; node != row; node = node->L) {
-                node->C->size++;
-                node->D->U = node;
-                node->U->D = node;
+    // The GPU engine runs the CPU bitboard engine for whatever it hands back
+    bool useGpu = opt.engine == SudokuEngine::Gpu;
+    const SudokuEngine cpuEngine = useGpu ? SudokuEngine::Bitboard : opt.engine;
+
+    WorkStealingPool pool(opt.threads);
+    vector<unique_ptr<BatchWorker>> workers;
+    for (int i = 0; i < pool.size(); i++)
+        workers.emplace_back(new BatchWorker());
+
+    // Search counters describe real searches, so --stats bypasses the cache
+    unique_ptr<SolutionCache> cache;
+    if (opt.cacheBytes && !wantStats) cache.reset(new SolutionCache(opt.cacheBytes));
+
+    struct Block {
+        vector<Grid> puzzles;
+        vector<Grid> solutions;     // all zeros when unsolved
+        vector<char> valid, solved;
+        vector<SearchStats> stats;  // only filled with --stats
+        vector<uint8_t> gpuStatus;  // GpuStatus per puzzle, empty when the GPU was not used
+        size_t count() const { return valid.size(); }
+    };
+
+    size_t malformed = 0, conflicting = 0, read = 0;
+    vector<ClueConflict> conflicts;
+
+    auto readBlock = [&](Block& b) {
+        b.puzzles.resize(BLOCK);
+        b.valid.clear();
+        while (b.valid.size() < BLOCK) {
+            Grid& grid = b.puzzles[b.valid.size()];
+            bool valid;
+            if (!source.next(grid, valid)) break;
+            if (!valid && ++malformed <= 10)
+                cerr << "ERROR: " << source.position() << " is not a valid puzzle.\n";
+            read++;
+
+            // Conflicting clues can never be solved: skip them without a search
+            if (valid && !validateClues(grid)) {
+                valid = false;
+                if (++conflicting <= 10) {
+                    conflicts.clear();
+                    validateClues(grid, &conflicts);
+                    cerr << "ERROR: Puzzle " << read << " has conflicting clues: "
+                        << describeConflict(conflicts[0]) << ".\n";
+                }
             }
+            b.valid.push_back(valid);
+        }
+        b.puzzles.resize(b.count());
+        b.solutions.assign(b.count(), Grid{});
+        b.solved.assign(b.count(), 0);
+        if (wantStats) b.stats.assign(b.count(), SearchStats());
+    };
+
+    size_t total = 0, solved = 0;
+    atomic<size_t> exceeded{ 0 };   // puzzles stopped by the budget
+    atomic<size_t> rejected{ 0 };   // solutions that failed verification
+    atomic<size_t> cacheHits{ 0 };
+    atomic<size_t> gpuFallbacks{ 0 };   // puzzles the GPU handed back to the CPU
+    atomic<size_t> byLogic{ 0 };    // puzzles --presolve finished without a search
+    mutex logicLock;
+    LogicReport logicTotal;         // technique counts summed over all puzzles
+    SolutionWriter writer(out, format);
+    string statsBuf;
+    auto writeBlock = [&](const Block& b) {
+        statsBuf.clear();
+        for (size_t i = 0; i < b.count(); i++) {
+            writer.write(b.solutions[i]);
+            if (wantStats) appendStatsCsv(statsBuf, total + i, b.solved[i] != 0, b.stats[i]);
+            solved += b.solved[i];
+        }
+        statsOut.write(statsBuf.data(), (streamsize)statsBuf.size());
+        total += b.count();
+    };
+
+    auto start = chrono::steady_clock::now();
+
+    Block cur, prev;
+    readBlock(cur);
+    while (cur.count() > 0) {
+        cur.gpuStatus.clear();
+        if (useGpu && !gpuSolveBlock(cur.puzzles, cur.valid, cur.solutions, cur.gpuStatus)) {
+            cur.gpuStatus.clear();
+            useGpu = false;
+        }
+        for (size_t first = 0; first < cur.count(); first += CHUNK) {
+            size_t last = min(first + CHUNK, cur.count());
+            Block* b = &cur;
+            pool.submit([&, b, first, last](int w) {
+                LogicReport logic, chunkLogic;
+                size_t chunkByLogic = 0;
+                auto search = [&](size_t i) {
+                    const Grid* puzzle = &b->puzzles[i];
+                    Grid forced;
+                    if (opt.presolve) {
+                        forced = *puzzle;
+                        bool ok = presolveSudoku(forced, &logic);
+                        chunkLogic.nakedSingles += logic.nakedSingles;
+                        chunkLogic.hiddenSingles += logic.hiddenSingles;
+                        chunkLogic.lockedCandidates += logic.lockedCandidates;
+                        if (!ok) return;
+                        if (logic.solved) {
+                            b->solutions[i] = forced;
+                            b->solved[i] = 1;
+                            chunkByLogic++;
+                            return;
+                        }
+                        puzzle = &forced;
+                    }
+                    SearchStats* st = wantStats ? &b->stats[i] : nullptr;
+                    if (!opt.budgeted()) {
+                        b->solved[i] = workers[w]->solve(cpuEngine, *puzzle, b->solutions[i], st);
+                        return;
+                    }
+                    SearchStatus status = workers[w]->solveWithin(opt, *puzzle, b->solutions[i], st);
+                    b->solved[i] = status == SearchStatus::Found;
+                    if (status == SearchStatus::BudgetExceeded) exceeded++;
+                };
+                for (size_t i = first; i < last; i++) {
+                    if (!b->valid[i]) continue;
+                    if (!b->gpuStatus.empty()) {
+                        if (b->gpuStatus[i] == GPU_SOLVED) {
+                            b->solved[i] = 1;
+                            continue;
+                        }
+                        b->solutions[i] = Grid{};
+                        if (b->gpuStatus[i] == GPU_NO_SOLUTION) continue;
+                        gpuFallbacks++;
+                    }
+                    if (!cache) {
+                        search(i);
+                        continue;
+                    }
+                    CanonicalPuzzle key(b->puzzles[i]);
+                    if (cache->lookup(key, b->solutions[i])) {
+                        b->solved[i] = 1;
+                        cacheHits++;
+                        continue;
+                    }
+                    search(i);
+                    if (b->solved[i]) cache->insert(key, b->solutions[i]);
+                }
+                if (opt.presolve) {
+                    byLogic += chunkByLogic;
+                    lock_guard<mutex> lock(logicLock);
+                    logicTotal.nakedSingles += chunkLogic.nakedSingles;
+                    logicTotal.hiddenSingles += chunkLogic.hiddenSingles;
+                    logicTotal.lockedCandidates += chunkLogic.lockedCandidates;
+                }
+
+                // Verify the chunk's solutions before they are written
+                uint8_t ok[CHUNK];
+                verifySudokuBatch(&b->solutions[first], last - first, ok);
+                for (size_t i = first; i < last; i++) {
+                    if (b->solved[i] && !ok[i - first]) {
+                        b->solved[i] = 0;
+                        b->solutions[i] = Grid{};
+                        rejected++;
+                    }
+                }
+            });
         }
-        c->R->L = c;
-        c->L->R = c;
+        writeBlock(prev);
+        readBlock(prev);   // read ahead into the spare block
+        pool.wait();
+        swap(cur, prev);
     }
+    writeBlock(prev);
+    writer.flush();
+    out.flush();
 
-    bool search() {
-        if (head.R == &head) return true; // all constraints satisfied
-
-        // Choose column with smallest size (heuristic)
-        Column* c = nullptr;
-        int minSize = 1000000000;
-        for (auto* j = (Column*)head.R; j != &head; j = (Column*)j->R) {
-            if (j->size < minSize) {
-                minSize = j->size;
-                c = j;
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (malformed)
+        cerr << malformed << " malformed puzzle " << (layout == PuzzleSource::Layout::Packed ? "record"
+            : layout == PuzzleSource::Layout::Line ? "line" : "grid") << "(s) skipped.\n";
+    if (conflicting)
+        cerr << conflicting << " puzzle(s) with conflicting clues skipped.\n";
+    if (exceeded)
+        cerr << exceeded << " puzzle(s) exceeded the search budget.\n";
+    if (rejected)
+        cerr << "ERROR: " << rejected << " solution(s) failed verification and were dropped.\n";
+    if (opt.presolve)
+        cerr << byLogic << " puzzle(s) solved by logic alone (" << logicTotal.nakedSingles << " naked singles, "
+            << logicTotal.hiddenSingles << " hidden singles, " << logicTotal.lockedCandidates
+            << " locked-candidate eliminations).\n";
+    if (gpuFallbacks)
+        cerr << gpuFallbacks << " puzzle(s) over the GPU step limit were solved on the CPU.\n";
+    if (cache)
+        cerr << cacheHits << " puzzle(s) answered from the cache (" << cache->capacity() << " slots).\n";
+    cerr << "Solved " << solved << " of " << total << " puzzles in " << secs << " s ("
+        << (secs > 0 ? total / secs : 0.0) << " puzzles/s, " << pool.size() << " threads)\n";
+    return 0;
+}
+
+// Batch solving for the other grid sizes: N lines of N numbers per puzzle,
+// DLX engine only. The whole file is read up front and solved on the pool;
+// malformed grids come out blank.
+template <int B>
+int runSizedBatch(const BatchOptions& opt) {
+    using GridType = BasicGrid<B>;
+    const size_t CHUNK = 4;      // puzzles per task
+
+    if (opt.engine != SudokuEngine::DLX || !opt.statsPath.empty() ||
+        (opt.format != OutputFormat::Auto && opt.format != OutputFormat::Grid)) {
+        cerr << "ERROR: --size " << opt.size << " only supports the dlx engine and grid output, without --stats.\n";
+        return 1;
+    }
+
+    MappedFile file(opt.input);
+    if (!file.isOpen()) {
+        cerr << "ERROR: Could not open file " << opt.input << ".\n";
+        return 1;
+    }
+    SudokuGridReader<B> reader(file.data(), file.size());
+    vector<GridType> puzzles;
+    vector<char> valid;
+    size_t malformed = 0;
+    GridType grid;
+    bool ok;
+    while (reader.next(grid.data(), ok)) {
+        if (!ok && ++malformed <= 10)
+            cerr << "ERROR: Grid at line " << reader.lineNumber()
+                << (reader.partial() ? " (cut short by the end of the file)" : "") << " is not a valid puzzle.\n";
+        puzzles.push_back(grid);
+        valid.push_back(ok);
+    }
+
+    ofstream fout;
+    ostream* dest = openOutput(opt.output, OutputFormat::Grid, fout);
+    if (!dest) return 1;
+    ostream& out = *dest;
+
+    auto start = chrono::steady_clock::now();
+
+    WorkStealingPool pool(opt.threads);
+    vector<unique_ptr<BasicSudokuSolver<B>>> workers;
+    for (int i = 0; i < pool.size(); i++)
+        workers.emplace_back(new BasicSudokuSolver<B>());
+
+    vector<GridType> solutions(puzzles.size(), GridType{});
+    vector<char> solved(puzzles.size(), 0);
+    for (size_t first = 0; first < puzzles.size(); first += CHUNK) {
+        size_t last = min(first + CHUNK, puzzles.size());
+        pool.submit([&, first, last](int w) {
+            BasicSudokuSolver<B>& solver = *workers[w];
+            for (size_t i = first; i < last; i++) {
+                if (!valid[i]) continue;
+                bool ok = opt.presolve ? solveSudokuWithLogic<B>(solver, puzzles[i]) : solver.solve(puzzles[i]);
+                if (!ok) continue;
+                solutions[i] = extractSolution<B>(solver.solution());
+                solved[i] = 1;
             }
-        }
-        if (!c || c->size == 0) return false; // dead end
+        });
+    }
+    pool.wait();
 
-        cover(c);
+    size_t count = 0;
+    for (size_t i = 0; i < puzzles.size(); i++) {
+        writeSudoku<B>(out, solutions[i]);
+        count += solved[i];
+    }
+    out.flush();
 
-        for (Node* r = c->D; r != c; r = r->D) {
-            solution.push_back(r->rowID);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (malformed)
+        cerr << malformed << " malformed puzzle grid(s) skipped.\n";
+    cerr << "Solved " << count << " of " << puzzles.size() << " " << opt.size << "x" << opt.size
+        << " puzzles in " << secs << " s (" << pool.size() << " threads)\n";
+    return 0;
+}
 
-            for (Node* j = r->R; j != r; j = j->R)
-                cover(j->C);
+// Rewrite a puzzle file in another layout, e.g. a text corpus into the
+// packed format once so later batch runs load it in one mapping
+int runConvert(const BatchOptions& opt) {
+    MappedFile file(opt.input);
+    if (!file.isOpen()) {
+        cerr << "ERROR: Could not open file " << opt.input << ".\n";
+        return 1;
+    }
+    PuzzleSource source(file.data(), file.size());
+    if (const char* why = source.error()) {
+        cerr << "ERROR: " << opt.input << " " << why << ".\n";
+        return 1;
+    }
+    if (opt.format == OutputFormat::Auto) {
+        cerr << "ERROR: --convert needs --format grid|line|packed.\n";
+        return 1;
+    }
+    ofstream fout;
+    ostream* dest = openOutput(opt.output, opt.format, fout);
+    if (!dest) return 1;
+    ostream& out = *dest;
 
-            if (search()) return true;
+    SolutionWriter writer(out, opt.format);
+    Grid grid;
+    bool valid;
+    size_t malformed = 0;
+    while (source.next(grid, valid)) {
+        if (!valid && ++malformed <= 10)
+            cerr << "ERROR: " << source.position() << " is not a valid puzzle.\n";
+        writer.write(grid);
+    }
+    writer.flush();
+    out.flush();
 
-            for (Node* j = r->L; j != r; j = j->L)
-                uncover(j->C);
+    if (malformed)
+        cerr << malformed << " malformed puzzle(s) written as blank grids.\n";
+    cerr << "Converted " << writer.written() << " puzzles.\n";
+    return 0;
+}
 
-            solution.pop_back();
-        }
+// Count the solutions of every puzzle in the input file across the pool
+// and write one count per line, in input order (0 for malformed puzzles
+// or conflicting clues). --symmetry breaks the digit symmetry
+// (countSolutionsBySymmetry): same counts, far fewer branches on grids
+// whose clues leave digits unused.
+int runCount(const BatchOptions& opt) {
+    const size_t BLOCK = 4096;   // puzzles per block; one puzzle per task, counts vary widely
 
-        uncover(c);
-        return false;
+    if (opt.size != 9 || opt.engine != SudokuEngine::DLX) {
+        cerr << "ERROR: --count only supports 9x9 puzzles and the dlx engine.\n";
+        return 1;
+    }
+    if (!opt.statsPath.empty() || opt.budgeted() || opt.presolve || opt.cacheBytes ||
+        opt.format != OutputFormat::Auto) {
+        cerr << "ERROR: --count writes counts only; it does not take --stats, --max-nodes, --timeout, "
+            "--presolve, --cache or --format.\n";
+        return 1;
     }
-};
-// ----------------- Sudoku Generator -----------------
 
-// Global RNG so both generator functions use the same random engine
-static std::mt19937 rng(random_device{}());
+    MappedFile file(opt.input);
+    if (!file.isOpen()) {
+        cerr << "ERROR: Could not open file " << opt.input << ".\n";
+        return 1;
+    }
+    PuzzleSource source(file.data(), file.size());
+    if (const char* why = source.error()) {
+        cerr << "ERROR: " << opt.input << " " << why << ".\n";
+        return 1;
+    }
 
-// Backtracking generator for a full valid Sudoku grid
-bool fillSudoku(vector<vector<int>>& grid, int r = 0, int c = 0) {
-    if (r == 9) return true;
+    ofstream fout;
+    ostream* dest = openOutput(opt.output, OutputFormat::Line, fout);
+    if (!dest) return 1;
+    ostream& out = *dest;
 
-    int nr = (c == 8) ? r + 1 : r;
-    int nc = (c == 8) ? 0 : c + 1;
+    const uint64_t limit = opt.countLimit ? opt.countLimit : ~(uint64_t)0;
+    WorkStealingPool pool(opt.threads);
+    vector<unique_ptr<SudokuSolver>> solvers;
+    for (int i = 0; i < pool.size(); i++)
+        solvers.emplace_back(new SudokuSolver());
 
-    vector<int> nums = { 1,2,3,4,5,6,7,8,9 };
-    std::shuffle(nums.begin(), nums.end(), rng);
+    vector<Grid> puzzles(BLOCK);
+    vector<char> valid;
+    vector<uint64_t> counts;
+    size_t malformed = 0, total = 0, limited = 0;
+    string buf;
+    auto start = chrono::steady_clock::now();
 
-    auto canPlace = [&](int r, int c, int val) {
-        for (int i = 0; i < 9; i++) {
-            if (grid[r][i] == val) return false;
-            if (grid[i][c] == val) return false;
+    while (true) {
+        valid.clear();
+        bool ok;
+        while (valid.size() < BLOCK && source.next(puzzles[valid.size()], ok)) {
+            if (!ok && ++malformed <= 10)
+                cerr << "ERROR: " << source.position() << " is not a valid puzzle.\n";
+            valid.push_back(ok);
+        }
+        if (valid.empty()) break;
 
-            int br = 3 * (r / 3) + i / 3;
-            int bc = 3 * (c / 3) + i % 3;
-            if (grid[br][bc] == val) return false;
+        counts.assign(valid.size(), 0);
+        for (size_t i = 0; i < valid.size(); i++) {
+            if (!valid[i]) continue;
+            pool.submit([&, i](int w) {
+                counts[i] = opt.symmetry ? solvers[w]->countSolutionsBySymmetry(puzzles[i], limit)
+                                         : solvers[w]->countSolutions(puzzles[i], limit);
+            });
         }
-        return true;
-    };
+        pool.wait();
 
-    for (int val : nums) {
-        if (canPlace(r, c, val)) {
-            grid[r][c] = val;
-            if (fillSudoku(grid, nr, nc)) return true;
-            grid[r][c] = 0;
+        buf.clear();
+        for (uint64_t c : counts) {
+            buf += to_string(c);
+            buf += '\n';
+            limited += c == limit;
         }
+        out.write(buf.data(), (streamsize)buf.size());
+        total += valid.size();
     }
-    return false;
+    out.flush();
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (malformed)
+        cerr << malformed << " malformed puzzle(s) counted as 0.\n";
+    if (opt.countLimit && limited)
+        cerr << limited << " puzzle(s) reached the --limit of " << opt.countLimit << ".\n";
+    cerr << "Counted " << total << " puzzles in " << secs << " s (" << pool.size() << " threads"
+        << (opt.symmetry ? ", digit symmetry broken" : "") << ")\n";
+    return 0;
 }
 
-// Remove <removeCount> random cells to make a puzzle
-vector<vector<int>> generateSudokuPuzzle(int removeCount = 40) {
-    vector<vector<int>> grid(9, vector<int>(9, 0));
-    fillSudoku(grid); // generate a complete valid solution
+// ----------------- Solver service -----------------
+// --serve answers puzzles over a line protocol on stdin / stdout or, with
+// --port, on TCP connections to 127.0.0.1. Each request is one puzzle in the
+// 81-character line format; each reply is one line, in request order:
+//   81 digits     the solution
+//   NONE          the puzzle has no solution
+//   ERROR <why>   malformed line, conflicting clues or over the search budget
+// Blank lines get no reply. Clients may pipeline: every complete line that
+// has arrived is answered as one batch (small batches on the connection's
+// own thread, larger ones split across the shared pool) and the replies go
+// back in a single write. Solvers stay warm between requests.
 
-    vector<pair<int, int>> pos;
-    for (int r = 0; r < 9; r++)
-        for (int c = 0; c < 9; c++)
-            pos.emplace_back(r, c);
+class SolveService {
+public:
+    // Per-connection state, reused for every batch on that connection
+    struct Session {
+        BatchWorker worker;         // solves batches too small for the pool
+        string pending;             // bytes received but not yet answered
+        string replies;             // filled by answer()
+        vector<Grid> puzzles, solutions;
+        vector<uint8_t> state;      // Reply per request
+        size_t answered = 0;
+    };
 
-    std::shuffle(pos.begin(), pos.end(), rng);
+    static const size_t MAX_LINE = 4096;    // longer lines end the connection
 
-    for (int k = 0; k < removeCount; k++)
-        grid[pos[k].first][pos[k].second] = 0;
+    explicit SolveService(const BatchOptions& opt) : opt(opt), pool(opt.threads) {
+        for (int i = 0; i < pool.size(); i++)
+            workers.emplace_back(new BatchWorker());
+        if (opt.cacheBytes) cache.reset(new SolutionCache(opt.cacheBytes));
+    }
 
-    return grid;
-}
+    int threads() const { return pool.size(); }
 
-// ----------------- Sudoku-specific helpers -----------------
+    // Answer every complete line in s.pending into s.replies (which is
+    // cleared first); a trailing partial line stays in s.pending
+    void answer(Session& s) {
+        s.replies.clear();
+        s.puzzles.clear();
+        s.state.clear();
 
-const int N = 9;
-const int N2 = N * N;      // 81
-const int COLS = 4 * N2;     // 324 columns
-
-inline int boxIndex(int r, int c) {
-    return (r / 3) * 3 + (c / 3);
-}
-
-// Fill an existing DLX with the full Sudoku exact-cover matrix
-void buildSudokuDLX(DLX& dlx) {
-    // For each possible (row, col, digit)
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            for (int d = 0; d < N; d++) {
-                // Four constraint columns
-                int cell_idx = r * N + c;                       // cell
-                int rowdig_idx = N2 + r * N + d;                  // row-digit
-                int coldig_idx = 2 * N2 + c * N + d;              // col-digit
-                int boxdig_idx = 3 * N2 + boxIndex(r, c) * N + d; // box-digit
-
-                vector<int> colIndices = {
-                    cell_idx,
-                    rowdig_idx,
-                    coldig_idx,
-                    boxdig_idx
-                };
+        const char* p = s.pending.data();
+        const char* end = p + s.pending.size();
+        while (const char* eol = (const char*)memchr(p, '\n', (size_t)(end - p))) {
+            const char* line = p;
+            size_t len = (size_t)(eol - line);
+            if (len && line[len - 1] == '\r') len--;
+            p = eol + 1;
+            if (len == 0) continue;
 
-                vector<Node*> rowNodes;
-                rowNodes.reserve(4);
+            s.puzzles.emplace_back();
+            Grid& grid = s.puzzles.back();
+            uint8_t st = Pending;
+            if (!parseSudokuLine(line, len, grid.data())) st = Malformed;
+            else if (!validateClues(grid)) st = Conflicting;
+            s.state.push_back(st);
+        }
+        s.pending.erase(0, (size_t)(p - s.pending.data()));
 
-                int rowID = r * N2 + c * N + d; // (r,c,d) encoded 0–728
-                for (int idx : colIndices) {
-                    rowNodes.push_back(dlx.addNode(idx, rowID));
-                }
+        const size_t n = s.puzzles.size();
+        if (n == 0) return;
+        s.solutions.assign(n, Grid{});
+
+        if (n <= CHUNK || pool.size() == 1) {
+            solveRange(s.worker, s, 0, n);
+        }
+        else {
+            // Wait on this batch only: other connections share the pool
+            size_t chunks = (n + CHUNK - 1) / CHUNK, left = chunks;
+            mutex m;
+            condition_variable done;
+            for (size_t first = 0; first < n; first += CHUNK) {
+                size_t last = min(first + CHUNK, n);
+                pool.submit([&, first, last](int w) {
+                    solveRange(*workers[w], s, first, last);
+                    lock_guard<mutex> lk(m);
+                    if (--left == 0) done.notify_one();
+                });
+            }
+            unique_lock<mutex> lk(m);
+            done.wait(lk, [&] { return left == 0; });
+        }
 
-                DLX::linkRow(rowNodes);
+        s.replies.reserve(n * 82);
+        for (size_t i = 0; i < n; i++) {
+            switch (s.state[i]) {
+            case Solved: {
+                char line[82];
+                for (int c = 0; c < 81; c++)
+                    line[c] = (char)('0' + s.solutions[i][c]);
+                line[81] = '\n';
+                s.replies.append(line, sizeof line);
+                break;
+            }
+            case Malformed:   s.replies += "ERROR malformed puzzle\n"; break;
+            case Conflicting: s.replies += "ERROR conflicting clues\n"; break;
+            case OverBudget:  s.replies += "ERROR search budget exceeded\n"; break;
+            case Failed:      s.replies += "ERROR internal failure\n"; break;
+            default:          s.replies += "NONE\n"; break;
             }
         }
+        s.answered += n;
     }
-}
 
-// Force the given clues into the DLX structure
-void applyInitialSudoku(DLX& dlx, const vector<vector<int>>& grid) {
-    for (int r = 0; r < 9; r++) {
-        for (int c = 0; c < 9; c++) {
-            int d = grid[r][c];
-            if (d == 0) continue; // skip empty
+private:
+    enum Reply : uint8_t { Pending, Solved, Unsolvable, Malformed, Conflicting, OverBudget, Failed };
+
+    static const size_t CHUNK = 32;  // requests per pool task
 
-            int rowID = r * 81 + c * 9 + (d - 1);
+    BatchOptions opt;
+    WorkStealingPool pool;
+    vector<unique_ptr<BatchWorker>> workers;
+    unique_ptr<SolutionCache> cache;
 
-            Node* rowNode = nullptr;
-            for (auto* n : dlx.nodes) {
-                if (n->rowID == rowID) {
-                    rowNode = n;
-                    break;
+    void solveRange(BatchWorker& worker, Session& s, size_t first, size_t last) {
+        for (; first < last; first += CHUNK) {
+            size_t stop = min(first + CHUNK, last);
+            try {
+                for (size_t i = first; i < stop; i++) {
+                    if (s.state[i] == Pending) s.state[i] = solveOne(worker, s.puzzles[i], s.solutions[i]);
+                }
+            }
+            catch (...) {   // e.g. bad_alloc: fail the requests, keep serving
+                for (size_t i = first; i < stop; i++) {
+                    if (s.state[i] == Pending) s.state[i] = Failed;
                 }
             }
 
-            if (!rowNode) {
-                cerr << "ERROR: could not find rowID " << rowID
-                    << " for given (" << r << "," << c << ")=" << d << endl;
-                continue;
+            uint8_t ok[CHUNK];
+            verifySudokuBatch(&s.solutions[first], stop - first, ok);
+            for (size_t i = first; i < stop; i++) {
+                if (s.state[i] == Solved && !ok[i - first]) s.state[i] = Failed;
             }
+        }
+    }
 
-            // record given as part of solution
-            dlx.solution.push_back(rowID);
+    uint8_t solveOne(BatchWorker& worker, const Grid& puzzle, Grid& out) {
+        if (!cache) return search(worker, puzzle, out);
+        CanonicalPuzzle key(puzzle);
+        if (cache->lookup(key, out)) return Solved;
+        uint8_t st = search(worker, puzzle, out);
+        if (st == Solved) cache->insert(key, out);
+        return st;
+    }
 
-            // cover all columns touched by this row
-            Node* cur = rowNode;
-            do {
-                DLX::cover(cur->C);
-                cur = cur->R;
-            } while (cur != rowNode);
+    uint8_t search(BatchWorker& worker, const Grid& puzzle, Grid& out) {
+        const Grid* p = &puzzle;
+        Grid forced;
+        if (opt.presolve) {
+            forced = puzzle;
+            LogicReport logic;
+            if (!presolveSudoku(forced, &logic)) return Unsolvable;
+            if (logic.solved) {
+                out = forced;
+                return Solved;
+            }
+            p = &forced;
         }
+
+        if (!opt.budgeted()) return worker.solve(opt.engine, *p, out) ? Solved : Unsolvable;
+        SearchStatus status = worker.solveWithin(opt, *p, out);
+        return status == SearchStatus::Found ? Solved
+            : status == SearchStatus::BudgetExceeded ? OverBudget : Unsolvable;
     }
-}
+};
 
-bool solveSudoku(DLX& dlx) {
-    return dlx.search();
-}
+const size_t SolveService::MAX_LINE;
+const size_t SolveService::CHUNK;
+
+#if defined(_WIN32)
+using SocketHandle = SOCKET;
+const SocketHandle NO_SOCKET = INVALID_SOCKET;
+inline void closeSocket(SocketHandle s) { closesocket(s); }
+#else
+using SocketHandle = int;
+const SocketHandle NO_SOCKET = -1;
+inline void closeSocket(SocketHandle s) { close(s); }
+#endif
 
-// Convert solution rowIDs back into a 9x9 grid
-vector<vector<int>> extractSolution(const vector<int>& solution) {
-    vector<vector<int>> grid(9, vector<int>(9, 0));
+// Byte stream a session runs over: stdin / stdout, or one TCP socket
+class ServeChannel {
+public:
+    // stdin / stdout
+    ServeChannel() = default;
+    explicit ServeChannel(SocketHandle s) : sock(s) {}
 
-    for (int rowID : solution) {
-        int r = rowID / 81;
-        int c = (rowID / 9) % 9;
-        int d = (rowID % 9) + 1;
-        grid[r][c] = d;
+    // Up to size bytes, blocking until some arrive; 0 at end of input, < 0 on error
+    long receive(char* buf, size_t size) {
+#if defined(_WIN32)
+        int chunk = (int)min(size, (size_t)1 << 30);
+        return sock == NO_SOCKET ? _read(0, buf, (unsigned)chunk) : recv(sock, buf, chunk, 0);
+#else
+        long n;
+        do {
+            n = sock == NO_SOCKET ? (long)read(0, buf, size) : (long)recv(sock, buf, size, 0);
+        } while (n < 0 && errno == EINTR);
+        return n;
+#endif
     }
-    return grid;
-}
 
-// ----------------- IO and utility helpers -----------------
+    bool sendAll(const char* data, size_t size) {
+        while (size) {
+            long n;
+#if defined(_WIN32)
+            int chunk = (int)min(size, (size_t)1 << 30);
+            n = sock == NO_SOCKET ? _write(1, data, (unsigned)chunk) : send(sock, data, chunk, 0);
+#else
+            n = sock == NO_SOCKET ? (long)write(1, data, size) : (long)send(sock, data, size, 0);
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            if (n <= 0) return false;
+            data += n;
+            size -= (size_t)n;
+        }
+        return true;
+    }
 
-bool readSudokuFromStream(istream& in, vector<vector<int>>& grid) {
-    grid.assign(9, vector<int>(9, 0));
+private:
+    SocketHandle sock = NO_SOCKET;
+};
 
-    for (int r = 0; r < 9; ++r) {
-        for (int c = 0; c < 9; ++c) {
-            int x;
-            if (!(in >> x)) {
-                return false;
-            }
-            if (x < 0 || x > 9) {
-                return false;
-            }
-            grid[r][c] = x;
+// Answer requests until the peer closes the channel; returns the number answered
+size_t serveSession(SolveService& service, ServeChannel& channel) {
+    SolveService::Session s;
+    vector<char> buf(1 << 16);
+    long n;
+    while ((n = channel.receive(buf.data(), buf.size())) > 0) {
+        s.pending.append(buf.data(), (size_t)n);
+        service.answer(s);
+        if (!channel.sendAll(s.replies.data(), s.replies.size())) return s.answered;
+        if (s.pending.size() > SolveService::MAX_LINE) {
+            const char msg[] = "ERROR line too long\n";
+            channel.sendAll(msg, sizeof msg - 1);
+            return s.answered;
         }
     }
-    return true;
+    if (n == 0 && !s.pending.empty()) {     // last line without a newline
+        s.pending += '\n';
+        service.answer(s);
+        channel.sendAll(s.replies.data(), s.replies.size());
+    }
+    return s.answered;
 }
 
+// Accept connections on 127.0.0.1:port forever, one thread per connection
+int serveTcp(const shared_ptr<SolveService>& service, int port) {
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        cerr << "ERROR: Could not initialise Winsock.\n";
+        return 1;
+    }
+#endif
+    SocketHandle listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == NO_SOCKET) {
+        cerr << "ERROR: Could not create a socket.\n";
+        return 1;
+    }
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof on);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    if (::bind(listener, (sockaddr*)&addr, sizeof addr) != 0 || listen(listener, 64) != 0) {
+        cerr << "ERROR: Could not listen on port " << port << ".\n";
+        closeSocket(listener);
+        return 1;
+    }
+    socklen_t len = sizeof addr;
+    getsockname(listener, (sockaddr*)&addr, &len);  // the real port when port is 0
+    cerr << "Listening on 127.0.0.1:" << ntohs(addr.sin_port) << " (" << service->threads() << " threads)\n";
 
-// Pretty-print with . and 3x3 box lines
-void printSudokuPretty(const vector<vector<int>>& grid, const string& label) {
-    cout << label << ":\n";
-    for (int r = 0; r < 9; ++r) {
-        if (r != 0 && r % 3 == 0)
-            cout << "------+-------+------\n";
-        for (int c = 0; c < 9; ++c) {
-            if (c != 0 && c % 3 == 0)
-                cout << "| ";
-            int v = grid[r][c];
-            if (v == 0) cout << ". ";
-            else        cout << v << " ";
+    while (true) {
+        SocketHandle client = accept(listener, nullptr, nullptr);
+        if (client == NO_SOCKET) {
+#if !defined(_WIN32)
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+#endif
+            cerr << "ERROR: accept failed; the server is stopping.\n";
+            closeSocket(listener);
+            return 1;
         }
-        cout << '\n';
+        // Replies are written a batch at a time, so don't hold them back
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof on);
+        thread([service, client] {
+            ServeChannel channel(client);
+            serveSession(*service, channel);
+            closeSocket(client);
+        }).detach();
     }
 }
 
-// Check whether a completed grid is a valid Sudoku solution
-bool checkSudoku(const vector<vector<int>>& grid) {
-    // Check rows and columns
-    for (int i = 0; i < 9; ++i) {
-        vector<bool> row(10, false), col(10, false);
-        for (int j = 0; j < 9; ++j) {
-            int rv = grid[i][j];
-            int cv = grid[j][i];
-            if (rv < 1 || rv > 9 || cv < 1 || cv > 9) return false;
-            if (row[rv] || col[cv]) return false;
-            row[rv] = col[cv] = true;
-        }
-    }
-
-    // Check 3x3 boxes
-    for (int br = 0; br < 9; br += 3) {
-        for (int bc = 0; bc < 9; bc += 3) {
-            vector<bool> box(10, false);
-            for (int r = 0; r < 3; ++r) {
-                for (int c = 0; c < 3; ++c) {
-                    int v = grid[br + r][bc + c];
-                    if (v < 1 || v > 9) return false;
-                    if (box[v]) return false;
-                    box[v] = true;
-                }
-            }
-        }
+// port < 0 serves stdin / stdout until end of input
+int runServe(const BatchOptions& opt, int port) {
+    if (opt.size != 9 || opt.engine == SudokuEngine::Gpu || !opt.statsPath.empty()) {
+        cerr << "ERROR: --serve only supports 9x9 puzzles with the dlx or bitboard engine, without --stats.\n";
+        return 1;
     }
+    if (opt.budgeted() && opt.engine != SudokuEngine::DLX) {
+        cerr << "ERROR: --max-nodes and --timeout need the dlx engine.\n";
+        return 1;
+    }
+#if !defined(_WIN32)
+    signal(SIGPIPE, SIG_IGN);   // a vanished client shows up as a failed write instead
+#endif
 
-    return true;
+    // Connection threads are detached, so they share ownership of the service
+    auto service = make_shared<SolveService>(opt);
+    if (port >= 0) return serveTcp(service, port);
+
+    ServeChannel channel;
+    size_t answered = serveSession(*service, channel);
+    cerr << "Answered " << answered << " requests.\n";
+    return 0;
 }
 
-bool quit(const string& msg) {
-    while (true) {
-        cout << msg;
-        string inp;
-        if (!(cin >> inp)) {
-            return true;
-        }
-        transform(inp.begin(), inp.end(), inp.begin(),
-            [](unsigned char ch) { return std::tolower(ch); });
+// ----------------- Batch generation -----------------
 
-        if (inp == "y" || inp == "yes") return true;
-        if (inp == "n" || inp == "no")  return false;
+struct GenerateOptions {
+    size_t count = 0;                       // puzzles to generate
+    Difficulty level = Difficulty::Any;
+    uint64_t seed = 0;                      // 0 = seed from random_device
+    int threads = 0;                        // 0 = one per hardware thread
+    string output;                          // puzzles file, empty = stdout
+    OutputFormat format = OutputFormat::Line;
+};
 
-        cerr << "ERROR: Not valid input, enter 'y' or 'n'.\n";
+// Generate unique puzzles across a work-stealing pool, one generator per
+// worker. Puzzle i is always generated from seed + i, so the output (one
+// 81-character line per puzzle by default) does not depend on the thread count.
+int runGenerate(const GenerateOptions& opt) {
+    const size_t BLOCK = 4096;   // puzzles per block
+    const size_t CHUNK = 16;     // puzzles per task
+
+    const OutputFormat format = opt.format == OutputFormat::Auto ? OutputFormat::Line : opt.format;
+    ofstream fout;
+    ostream* dest = openOutput(opt.output, format, fout);
+    if (!dest) return 1;
+    ostream& out = *dest;
+    SolutionWriter writer(out, format);
+
+    uint64_t seed = opt.seed ? opt.seed : ((uint64_t)random_device{}() << 32 | random_device{}());
+
+    WorkStealingPool pool(opt.threads);
+    vector<unique_ptr<PuzzleGenerator>> generators;
+    for (int i = 0; i < pool.size(); i++)
+        generators.emplace_back(new PuzzleGenerator());
+
+    vector<Grid> puzzles;
+    vector<char> inRange;
+    size_t missed = 0;
+    auto start = chrono::steady_clock::now();
+
+    for (size_t base = 0; base < opt.count; base += BLOCK) {
+        size_t n = min(BLOCK, opt.count - base);
+        puzzles.resize(n);
+        inRange.assign(n, 0);
+
+        for (size_t first = 0; first < n; first += CHUNK) {
+            size_t last = min(first + CHUNK, n);
+            pool.submit([&, base, first, last](int w) {
+                PuzzleGenerator& gen = *generators[w];
+                for (size_t i = first; i < last; i++) {
+                    gen.seed(mixSeed(seed + base + i));
+                    inRange[i] = gen.generate(opt.level, puzzles[i]);
+                }
+            });
+        }
+        pool.wait();
+
+        for (size_t i = 0; i < n; i++) {
+            writer.write(puzzles[i]);
+            missed += !inRange[i];
+        }
     }
+    writer.flush();
+    out.flush();
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (missed)
+        cerr << missed << " puzzle(s) fell outside the requested difficulty range.\n";
+    cerr << "Generated " << opt.count << " unique puzzles in " << secs << " s ("
+        << (secs > 0 ? opt.count / secs : 0.0) << " puzzles/s, " << pool.size() << " threads)\n";
+    return 0;
 }
 
-bool isInteger(const string& s, int& value) {
+bool isUnsigned(const string& s, uint64_t& value) {
     try {
         size_t idx;
-        value = std::stoi(s, &idx);
+        if (s.empty() || s[0] == '-') return false;
+        value = std::stoull(s, &idx);
         return idx == s.size();
     }
     catch (...) {
@@ -418,40 +4227,217 @@ bool isInteger(const string& s, int& value) {
     }
 }
 
-int getChoice(const string& msg, const vector<int>& options) {
-    while (true) {
-        cout << msg;
-        string inp;
-        if (!(cin >> inp)) {
-            cerr << "ERROR: Input failure.\n";
-            return options.front();
-        }
+void printUsage(const char* prog) {
+    cerr << "Usage:\n"
+        "  " << prog << "                 interactive menu\n"
+        "  " << prog << " --batch <file> [--out <file>] [--threads <n>]\n"
+        "      [--engine dlx|bitboard|gpu] (gpu needs a -DDLSS_WITH_CUDA build with\n"
+        "      DLSS_cuda.cu linked in, otherwise it runs the bitboard engine;\n"
+        "      it cannot be combined with --cache or --presolve)\n"
+        "      <file> holds one 81-character puzzle per line (. or 0 = blank),\n"
+        "      9 lines of 9 numbers per puzzle, or packed records (see --convert)\n"
+        "      [--stats <csv>] writes per-puzzle DLX search counters\n"
+        "      [--max-nodes <n>] [--timeout <ms>] per-puzzle DLX search budget;\n"
+        "      puzzles over budget come out blank\n"
+        "      [--size 4|9|16|25] grid side; sizes other than 9 read N lines of N\n"
+        "      numbers per puzzle and use the dlx engine\n"
+        "      [--format grid|line|packed] output layout (default: same as input;\n"
+        "      packed = 4 bits per cell, needs --out)\n"
+        "      [--presolve] fill cells forced by singles and locked candidates\n"
+        "      before searching; reports how many puzzles needed no search\n"
+        "      [--cache <MB>] reuse solutions across puzzles that are transforms of\n"
+        "      one another (9x9 only; a multi-solution puzzle may get a different one)\n"
+        "  " << prog << " --count <file> [--symmetry] [--limit <n>] [--out <file>] [--threads <n>]\n"
+        "      write the number of solutions of each 9x9 puzzle, one per line;\n"
+        "      --symmetry skips branches that only relabel digits no clue uses\n"
+        "  " << prog << " --convert <file> --format grid|line|packed [--out <file>]\n"
+        "      rewrite a puzzle file in another layout; packed files load fastest\n"
+        "  " << prog << " --serve [--port <n>] [--threads <n>] [--engine dlx|bitboard]\n"
+        "      [--presolve] [--cache <MB>] [--max-nodes <n>] [--timeout <ms>]\n"
+        "      answer one 81-character puzzle per line with one line each (the\n"
+        "      solution, NONE or ERROR <reason>) in order; requests may be\n"
+        "      pipelined. Reads stdin and writes stdout, or with --port accepts\n"
+        "      TCP connections on 127.0.0.1\n"
+        "  " << prog << " --generate <count> [--difficulty any|easy|medium|hard|expert]\n"
+        "      [--seed <n>] [--out <file>] [--threads <n>] [--format line|grid|packed]\n";
+}
 
-        int choice;
-        if (isInteger(inp, choice) &&
-            find(options.begin(), options.end(), choice) != options.end())
-        {
-            return choice;
-        }
+// Non-interactive entry point; returns the process exit code
+int runCommandLine(int argc, char* argv[]) {
+    BatchOptions opt;
+    GenerateOptions gen;
+    bool batch = false, generate = false, convert = false, serve = false, count = false;
+    int port = -1;
 
-        cout << "ERROR: Not a valid choice. Valid options are: ";
-        for (size_t i = 0; i < options.size(); ++i) {
-            cout << options[i];
-            if (i + 1 < options.size()) cout << " or ";
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--batch" && hasValue) {
+            batch = true;
+            opt.input = argv[++i];
         }
-        cout << ".\n";
+        else if (arg == "--count" && hasValue) {
+            count = true;
+            opt.input = argv[++i];
+        }
+        else if (arg == "--symmetry") {
+            opt.symmetry = true;
+        }
+        else if (arg == "--limit" && hasValue) {
+            if (!isUnsigned(argv[++i], opt.countLimit) || opt.countLimit == 0) {
+                cerr << "ERROR: --limit needs a positive integer.\n";
+                return 1;
+            }
+        }
+        else if (arg == "--convert" && hasValue) {
+            convert = true;
+            opt.input = argv[++i];
+        }
+        else if (arg == "--generate" && hasValue) {
+            uint64_t count;
+            if (!isUnsigned(argv[++i], count)) {
+                cerr << "ERROR: --generate needs a puzzle count.\n";
+                return 1;
+            }
+            generate = true;
+            gen.count = (size_t)count;
+        }
+        else if (arg == "--serve") {
+            serve = true;
+        }
+        else if (arg == "--port" && hasValue) {
+            if (!isInteger(argv[++i], port) || port < 0 || port > 65535) {
+                cerr << "ERROR: --port needs a port number (0-65535, 0 = any free port).\n";
+                return 1;
+            }
+        }
+        else if (arg == "--out" && hasValue) {
+            opt.output = gen.output = argv[++i];
+        }
+        else if (arg == "--format" && hasValue) {
+            string f = argv[++i];
+            if (f == "grid") opt.format = OutputFormat::Grid;
+            else if (f == "line") opt.format = OutputFormat::Line;
+            else if (f == "packed") opt.format = OutputFormat::Packed;
+            else {
+                cerr << "ERROR: Unknown format '" << f << "'.\n";
+                return 1;
+            }
+            gen.format = opt.format;
+        }
+        else if (arg == "--threads" && hasValue) {
+            if (!isInteger(argv[++i], opt.threads) || opt.threads < 0) {
+                cerr << "ERROR: --threads needs a non-negative integer.\n";
+                return 1;
+            }
+            gen.threads = opt.threads;
+        }
+        else if (arg == "--engine" && hasValue) {
+            string e = argv[++i];
+            if (e == "dlx") opt.engine = SudokuEngine::DLX;
+            else if (e == "bitboard") opt.engine = SudokuEngine::Bitboard;
+            else if (e == "gpu") opt.engine = SudokuEngine::Gpu;
+            else {
+                cerr << "ERROR: Unknown engine '" << e << "'.\n";
+                return 1;
+            }
+        }
+        else if (arg == "--stats" && hasValue) {
+            opt.statsPath = argv[++i];
+        }
+        else if (arg == "--max-nodes" && hasValue) {
+            if (!isUnsigned(argv[++i], opt.maxNodes) || opt.maxNodes == 0) {
+                cerr << "ERROR: --max-nodes needs a positive integer.\n";
+                return 1;
+            }
+        }
+        else if (arg == "--timeout" && hasValue) {
+            int ms;
+            if (!isInteger(argv[++i], ms) || ms <= 0) {
+                cerr << "ERROR: --timeout needs a positive number of milliseconds.\n";
+                return 1;
+            }
+            opt.timeoutMs = ms;
+        }
+        else if (arg == "--presolve") {
+            opt.presolve = true;
+        }
+        else if (arg == "--cache" && hasValue) {
+            int mb;
+            if (!isInteger(argv[++i], mb) || mb <= 0) {
+                cerr << "ERROR: --cache needs a positive number of megabytes.\n";
+                return 1;
+            }
+            opt.cacheBytes = (size_t)mb << 20;
+        }
+        else if (arg == "--size" && hasValue) {
+            if (!isInteger(argv[++i], opt.size) ||
+                (opt.size != 4 && opt.size != 9 && opt.size != 16 && opt.size != 25)) {
+                cerr << "ERROR: --size must be 4, 9, 16 or 25.\n";
+                return 1;
+            }
+        }
+        else if (arg == "--difficulty" && hasValue) {
+            string d = argv[++i];
+            if (d == "any") gen.level = Difficulty::Any;
+            else if (d == "easy") gen.level = Difficulty::Easy;
+            else if (d == "medium") gen.level = Difficulty::Medium;
+            else if (d == "hard") gen.level = Difficulty::Hard;
+            else if (d == "expert") gen.level = Difficulty::Expert;
+            else {
+                cerr << "ERROR: Unknown difficulty '" << d << "'.\n";
+                return 1;
+            }
+        }
+        else if (arg == "--seed" && hasValue) {
+            if (!isUnsigned(argv[++i], gen.seed)) {
+                cerr << "ERROR: --seed needs a non-negative integer.\n";
+                return 1;
+            }
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (batch + generate + convert + serve + count != 1 || (port >= 0 && !serve)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if ((opt.symmetry || opt.countLimit) && !count) {
+        cerr << "ERROR: --symmetry and --limit only apply to --count.\n";
+        return 1;
+    }
+    if (serve) return runServe(opt, port);
+    if (count) return runCount(opt);
+    if (generate) return runGenerate(gen);
+    if (convert) return runConvert(opt);
+    switch (opt.size) {
+    case 4:  return runSizedBatch<2>(opt);
+    case 16: return runSizedBatch<4>(opt);
+    case 25: return runSizedBatch<5>(opt);
+    default: return runBatch(opt);
     }
 }
 
 // ----------------- main -----------------
+// Other targets (benchmarks) include this file with DLSS_FINAL_NO_MAIN defined
+#ifndef DLSS_FINAL_NO_MAIN
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) return runCommandLine(argc, argv);
 
-int main() {
     cout << "=====================================================\n"
         " Sudoku DLX Solver\n"
         "=====================================================\n";
 
+    SudokuSolver solver;       // reused for every puzzle
+    PuzzleGenerator generator; // unique puzzles for option 3
+
     do {
-        vector<vector<int>> grid;
+        Grid grid{};
         bool isValid = true;
 
         int choice = getChoice(
@@ -489,20 +4475,21 @@ int main() {
         }
         else {
             cout << "Generating puzzle...\n";
-            grid = generateSudokuPuzzle(40);   // remove 40 cells ? medium difficulty
+            generator.generate(Difficulty::Medium, grid);
         }
 
         if (isValid) {
             cout << "\nInput puzzle:\n";
             printSudokuPretty(grid, "Puzzle");
 
-            // Build fresh DLX structure for this puzzle
-            DLX dlx(COLS);
-            buildSudokuDLX(dlx);
-            applyInitialSudoku(dlx, grid);
-
-            if (solveSudoku(dlx)) {
-                auto solvedGrid = extractSolution(dlx.solution);
+            vector<ClueConflict> conflicts;
+            if (!validateClues(grid, &conflicts)) {
+                for (const auto& k : conflicts)
+                    cerr << "ERROR: Conflicting clues: " << describeConflict(k) << ".\n";
+                cout << "\nNo solution found for this puzzle.\n";
+            }
+            else if (solver.solve(grid)) {
+                auto solvedGrid = extractSolution(solver.solution());
                 cout << "\nSolved Sudoku:\n";
                 printSudokuPretty(solvedGrid, "Solution");
 
@@ -518,3 +4505,5 @@ int main() {
     } while (!quit("Would you like to quit (y or n): "));
     return 0;
 }
+
+#endif // DLSS_FINAL_NO_MAIN
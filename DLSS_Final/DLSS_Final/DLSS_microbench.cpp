@@ -0,0 +1,532 @@
+// Microbenchmarks for the DLX and Sudoku hot primitives.
+// Separate build target, like DLSS_bench.cpp:
+//   g++ -std=c++14 -O2 -pthread DLSS_microbench.cpp -o DLSS_microbench
+// Each benchmark times one primitive over a fixed working set of puzzles,
+// repeating until it has run for --min-time, and reports ns per call. On
+// Linux it also reads hardware counters (cycles, instructions, cache and
+// branch misses per call) through perf_event_open when the kernel allows
+// it (perf_event_paranoid <= 2); otherwise those columns show "-".
+#define DLSS_FINAL_NO_MAIN
+#include "DLSS_final.cpp"
+
+#include <iomanip>         // Table formatting
+#if defined(__linux__)
+#include <linux/perf_event.h>   // perf_event_attr
+#include <sys/ioctl.h>          // PERF_EVENT_IOC_*
+#include <sys/syscall.h>        // __NR_perf_event_open
+#endif
+
+// ----------------- Hardware counters -----------------
+
+enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTERS };
+
+// One counter per event, counting user-space work of this thread.
+// Counters that cannot be opened stay unavailable and read as zero.
+class PerfCounters {
+public:
+    PerfCounters() {
+        for (int& fd : fds) fd = -1;
+#if defined(__linux__)
+        const uint64_t events[COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (int i = 0; i < COUNTERS; i++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof attr;
+            attr.config = events[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds[i] >= 0) ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+#endif
+    }
+
+    bool available(int i) const { return fds[i] >= 0; }
+
+    // Current value of every counter
+    void read(uint64_t* values) const {
+        for (int i = 0; i < COUNTERS; i++) {
+            values[i] = 0;
+#if defined(__linux__)
+            if (fds[i] >= 0 && ::read(fds[i], &values[i], sizeof values[i]) != (ssize_t)sizeof values[i])
+                values[i] = 0;
+#endif
+        }
+    }
+
+private:
+    int fds[COUNTERS];
+};
+
+// ----------------- Measurement -----------------
+
+// Brackets the measured part of a batch; setup outside begin() / end()
+// is not counted
+class Meter {
+public:
+    explicit Meter(const PerfCounters& counters) : counters(counters) {}
+
+    void begin() {
+        counters.read(start);
+        t0 = chrono::steady_clock::now();
+    }
+
+    void end() {
+        auto t1 = chrono::steady_clock::now();
+        uint64_t stop[COUNTERS];
+        counters.read(stop);
+        ns += chrono::duration<double, nano>(t1 - t0).count();
+        for (int i = 0; i < COUNTERS; i++) totals[i] += stop[i] - start[i];
+    }
+
+    double ns = 0;
+    uint64_t totals[COUNTERS] = {};
+
+private:
+    const PerfCounters& counters;
+    chrono::steady_clock::time_point t0;
+    uint64_t start[COUNTERS] = {};
+};
+
+// A batch runs the primitive over the working set between meter.begin()
+// and meter.end() and returns how many calls it measured
+struct MicroBench {
+    string name;
+    function<uint64_t(Meter&)> batch;
+};
+
+struct MicroResult {
+    string name;
+    uint64_t calls = 0;
+    double ns = 0, minNs = 0;           // per call: mean, and fastest batch
+    double perCall[COUNTERS] = {};
+    bool counted[COUNTERS] = {};
+};
+
+// Warm up with one batch, then run batches until minMs has been measured
+MicroResult runMicro(const MicroBench& b, const PerfCounters& counters, double minMs) {
+    MicroResult res;
+    res.name = b.name;
+    {
+        Meter warm(counters);
+        b.batch(warm);
+    }
+
+    Meter total(counters);
+    res.minNs = numeric_limits<double>::max();
+    while (total.ns < minMs * 1e6) {
+        Meter m(counters);
+        uint64_t calls = b.batch(m);
+        if (calls == 0) break;
+        res.calls += calls;
+        res.minNs = min(res.minNs, m.ns / calls);
+        total.ns += m.ns;
+        for (int i = 0; i < COUNTERS; i++) total.totals[i] += m.totals[i];
+    }
+    if (res.calls == 0) {
+        res.minNs = 0;
+        return res;
+    }
+    res.ns = total.ns / res.calls;
+    for (int i = 0; i < COUNTERS; i++) {
+        res.counted[i] = counters.available(i);
+        res.perCall[i] = (double)total.totals[i] / res.calls;
+    }
+    return res;
+}
+
+// ----------------- Benchmarks -----------------
+
+// Puzzles the benchmarks run over, with their solutions
+struct WorkingSet {
+    vector<Grid> puzzles;
+    vector<vector<int>> solutions;  // rowIDs, clues included
+    vector<Grid> grids;             // solved grids
+};
+
+// Columns covered by the clue rows of a puzzle, in coverRow order
+vector<int> clueColumns(const Grid& puzzle) {
+    vector<int> cols;
+    const auto& t = sudokuTables<3>;
+    for (int i = 0; i < N2; i++) {
+        if (!puzzle[i]) continue;
+        int rowID = i * N + puzzle[i] - 1;
+        for (int k = 0; k < 4; k++) cols.push_back(t.columns[rowID][k]);
+    }
+    return cols;
+}
+
+// Keeps the optimizer from dropping results
+static volatile uint64_t sink;
+
+// Matrices the benchmarks work on, shared by their batches
+struct BenchState {
+    // One matrix per puzzle, so cover / uncover work over a realistic
+    // footprint instead of one cache-resident matrix
+    vector<SudokuDLX> arenas;
+    vector<unique_ptr<DLX>> pointers;
+    vector<vector<int>> columns;    // clue columns per puzzle
+    vector<SudokuDLX> applied;      // clues applied
+    unique_ptr<SudokuDLX> scratch;
+    WorkingSet ws;
+
+    explicit BenchState(const WorkingSet& w) : ws(w) {
+        const size_t count = ws.puzzles.size();
+        arenas.assign(count, pristineSudokuDLX());
+        applied.assign(count, pristineSudokuDLX());
+        scratch.reset(new SudokuDLX(pristineSudokuDLX()));
+        for (size_t i = 0; i < count; i++) {
+            pointers.emplace_back(new DLX(COLS));
+            buildSudokuDLX(*pointers.back());
+            columns.push_back(clueColumns(ws.puzzles[i]));
+            applyInitialSudoku(applied[i], ws.puzzles[i]);
+        }
+    }
+};
+
+// Cover every clue column of each puzzle in its own matrix (measured when
+// coverPhase), then uncover them again (measured otherwise).
+// matrix(i) is puzzle i's matrix, column(m, c) the handle of column c.
+template <class MatrixOf, class ColumnOf>
+uint64_t coverUncover(Meter& m, const BenchState& st, bool coverPhase, MatrixOf matrix, ColumnOf column) {
+    const size_t count = st.columns.size();
+    uint64_t calls = 0;
+    if (coverPhase) m.begin();
+    for (size_t i = 0; i < count; i++) {
+        auto& dlx = matrix(i);
+        for (int c : st.columns[i]) dlx.cover(column(dlx, c));
+        calls += st.columns[i].size();
+    }
+    if (coverPhase) m.end();
+    else m.begin();
+    for (size_t i = 0; i < count; i++) {
+        auto& dlx = matrix(i);
+        const vector<int>& cols = st.columns[i];
+        for (size_t k = cols.size(); k-- > 0;) dlx.uncover(column(dlx, cols[k]));
+    }
+    if (!coverPhase) m.end();
+    return calls;
+}
+
+vector<MicroBench> makeMicroBenches(const WorkingSet& ws) {
+    vector<MicroBench> benches;
+    auto st = make_shared<BenchState>(ws);
+
+    for (bool coverPhase : { true, false }) {
+        const string op = coverPhase ? "cover" : "uncover";
+        benches.push_back({ op + "/dlx-arena", [st, coverPhase](Meter& m) {
+            return coverUncover(m, *st, coverPhase,
+                [&](size_t i) -> SudokuDLX& { return st->arenas[i]; },
+                [](SudokuDLX&, int c) { return (uint16_t)(c + 1); });   // headers follow the root
+        } });
+        benches.push_back({ op + "/dlx-pointer", [st, coverPhase](Meter& m) {
+            return coverUncover(m, *st, coverPhase,
+                [&](size_t i) -> DLX& { return *st->pointers[i]; },
+                [](DLX& d, int c) { return (Node*)d.cols[c]; });
+        } });
+    }
+
+    // Column selection with the clues applied, as at the root of a search
+    for (ColumnSelection mode : { ColumnSelection::EarlyExit, ColumnSelection::MinScan }) {
+        string name = mode == ColumnSelection::EarlyExit ? "choose-column/early-exit" : "choose-column/min-scan";
+        benches.push_back({ name, [st, mode](Meter& m) {
+            uint64_t sum = 0;
+            for (SudokuDLX& d : st->applied) d.columnSelection = mode;
+            m.begin();
+            for (int rep = 0; rep < 16; rep++) {
+                for (SudokuDLX& d : st->applied) sum += d.chooseColumn();
+            }
+            m.end();
+            sink = sum;
+            return (uint64_t)st->applied.size() * 16;
+        } });
+    }
+
+    benches.push_back({ "build-sudoku-dlx/arena", [](Meter& m) {
+        m.begin();
+        for (int rep = 0; rep < 16; rep++) {
+            SudokuDLX dlx(COLS, 4 * N * N2);
+            buildSudokuDLX(dlx);
+            sink = dlx.size(1);
+        }
+        m.end();
+        return (uint64_t)16;
+    } });
+
+    benches.push_back({ "build-sudoku-dlx/pointer", [](Meter& m) {
+        m.begin();
+        for (int rep = 0; rep < 4; rep++) {
+            DLX dlx(COLS);
+            buildSudokuDLX(dlx);
+            sink = dlx.cols[0]->size;
+        }
+        m.end();
+        return (uint64_t)4;
+    } });
+
+    // The solver's per-puzzle reset, measured alone so it can be
+    // subtracted from apply-initial below
+    benches.push_back({ "restore", [st](Meter& m) {
+        m.begin();
+        for (int rep = 0; rep < 64; rep++) st->scratch->restore(pristineSudokuDLX());
+        m.end();
+        return (uint64_t)64;
+    } });
+
+    benches.push_back({ "apply-initial (with restore)", [st](Meter& m) {
+        m.begin();
+        for (const Grid& p : st->ws.puzzles) {
+            st->scratch->restore(pristineSudokuDLX());
+            sink = applyInitialSudoku(*st->scratch, p);
+        }
+        m.end();
+        return (uint64_t)st->ws.puzzles.size();
+    } });
+
+    benches.push_back({ "extract-solution", [st](Meter& m) {
+        uint64_t sum = 0;
+        m.begin();
+        for (int rep = 0; rep < 16; rep++) {
+            for (const vector<int>& s : st->ws.solutions) sum += extractSolution(s)[80];
+        }
+        m.end();
+        sink = sum;
+        return (uint64_t)st->ws.solutions.size() * 16;
+    } });
+
+    benches.push_back({ "check-sudoku", [st](Meter& m) {
+        uint64_t sum = 0;
+        m.begin();
+        for (int rep = 0; rep < 16; rep++) {
+            for (const Grid& g : st->ws.grids) sum += checkSudoku(g);
+        }
+        m.end();
+        sink = sum;
+        return (uint64_t)st->ws.grids.size() * 16;
+    } });
+
+    // Full counts with and without symmetry breaking: a solved grid keeping
+    // only digits 1-5, so 4 digits are interchangeable (24 solutions a class)
+    auto sparse = make_shared<Grid>(ws.grids[0]);
+    for (uint8_t& v : *sparse) {
+        if (v > 5) v = 0;
+    }
+    auto counter = make_shared<SudokuSolver>();
+    if (counter->countSolutions(*sparse, ~(uint64_t)0) != counter->countSolutionsBySymmetry(*sparse))
+        cerr << "ERROR: countSolutionsBySymmetry disagrees with countSolutions.\n";
+    benches.push_back({ "count-solutions/plain", [sparse, counter](Meter& m) {
+        m.begin();
+        sink = counter->countSolutions(*sparse, ~(uint64_t)0);
+        m.end();
+        return (uint64_t)1;
+    } });
+    benches.push_back({ "count-solutions/symmetry", [sparse, counter](Meter& m) {
+        m.begin();
+        sink = counter->countSolutionsBySymmetry(*sparse);
+        m.end();
+        return (uint64_t)1;
+    } });
+
+    // Generic orbit API: 8 queens, first-row placements paired by the mirror
+    const int QUEENS = 8;
+    ExactCoverProblem problem(2 * QUEENS, 2 * (2 * QUEENS - 1));
+    for (int r = 0; r < QUEENS; r++) {
+        for (int c = 0; c < QUEENS; c++)
+            problem.addRow({ r, QUEENS + c, 2 * QUEENS + r + c, 4 * QUEENS - 1 + r - c + QUEENS - 1 }, r * QUEENS + c);
+    }
+    auto queens = make_shared<ArenaDLX<uint16_t>>(problem.toArena<uint16_t>());
+    auto orbits = make_shared<vector<RowOrbit>>();
+    for (int c = 0; c < QUEENS / 2; c++) orbits->push_back({ c, 2 });   // row 0, columns c and 7 - c
+    if (queens->countSolutions() != queens->countSolutionsByOrbit(*orbits))
+        cerr << "ERROR: countSolutionsByOrbit disagrees with countSolutions.\n";
+    benches.push_back({ "count-queens/plain", [queens](Meter& m) {
+        m.begin();
+        sink = queens->countSolutions();
+        m.end();
+        return (uint64_t)1;
+    } });
+    benches.push_back({ "count-queens/orbit", [queens, orbits](Meter& m) {
+        m.begin();
+        sink = queens->countSolutionsByOrbit(*orbits);
+        m.end();
+        return (uint64_t)1;
+    } });
+
+    return benches;
+}
+
+// ----------------- Reporting -----------------
+
+const char* const COUNTER_NAMES[COUNTERS] = { "cycles", "instr", "cache-miss", "branch-miss" };
+const char* const COUNTER_KEYS[COUNTERS] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+void printMicroText(ostream& out, const vector<MicroResult>& results) {
+    out << left << setw(30) << "benchmark" << right << setw(11) << "calls"
+        << setw(11) << "ns/call" << setw(11) << "min ns";
+    for (const char* n : COUNTER_NAMES) out << setw(13) << n;
+    out << '\n' << fixed;
+    for (const auto& r : results) {
+        out << left << setw(30) << r.name << right << setw(11) << r.calls
+            << setprecision(1) << setw(11) << r.ns << setw(11) << r.minNs;
+        for (int i = 0; i < COUNTERS; i++) {
+            if (r.counted[i]) out << setprecision(2) << setw(13) << r.perCall[i];
+            else              out << setw(13) << "-";
+        }
+        out << '\n';
+    }
+}
+
+void printMicroCsv(ostream& out, const vector<MicroResult>& results) {
+    out << "benchmark,calls,ns_per_call,min_ns";
+    for (const char* k : COUNTER_KEYS) out << ',' << k;
+    out << '\n';
+    for (const auto& r : results) {
+        out << r.name << ',' << r.calls << ',' << r.ns << ',' << r.minNs;
+        for (int i = 0; i < COUNTERS; i++) {
+            out << ',';
+            if (r.counted[i]) out << r.perCall[i];
+        }
+        out << '\n';
+    }
+}
+
+void printMicroJson(ostream& out, const vector<MicroResult>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        out << "  {\"benchmark\": \"" << r.name << "\", \"calls\": " << r.calls
+            << ", \"ns_per_call\": " << r.ns << ", \"min_ns\": " << r.minNs;
+        for (int k = 0; k < COUNTERS; k++) {
+            out << ", \"" << COUNTER_KEYS[k] << "\": ";
+            if (r.counted[k]) out << r.perCall[k];
+            else              out << "null";
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    out << "]\n";
+}
+
+// ----------------- main -----------------
+
+void printMicroUsage(const char* prog) {
+    cerr << "Usage: " << prog << " [--corpus <file>] [--puzzles <n>] [--filter <text>]...\n"
+        "    [--min-time <ms>] [--format text|csv|json] [--out <file>]\n"
+        "  --corpus    puzzles to run over (any --batch input format); default:\n"
+        "              generated with a fixed seed\n"
+        "  --puzzles   working-set size (default 64)\n"
+        "  --filter    only run benchmarks whose name contains this text\n"
+        "  --min-time  measured time per benchmark (default 200 ms)\n";
+}
+
+int main(int argc, char* argv[]) {
+    string corpusFile, format = "text", output;
+    vector<string> filters;
+    int puzzleCount = 64, minMs = 200;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--corpus" && hasValue) corpusFile = argv[++i];
+        else if (arg == "--filter" && hasValue) filters.push_back(argv[++i]);
+        else if (arg == "--format" && hasValue) format = argv[++i];
+        else if (arg == "--out" && hasValue) output = argv[++i];
+        else if (arg == "--puzzles" && hasValue) {
+            if (!isInteger(argv[++i], puzzleCount) || puzzleCount < 1) {
+                cerr << "ERROR: --puzzles needs a positive integer.\n";
+                return 1;
+            }
+        }
+        else if (arg == "--min-time" && hasValue) {
+            if (!isInteger(argv[++i], minMs) || minMs < 1) {
+                cerr << "ERROR: --min-time needs a positive number of milliseconds.\n";
+                return 1;
+            }
+        }
+        else {
+            printMicroUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (format != "text" && format != "csv" && format != "json") {
+        cerr << "ERROR: Unknown format '" << format << "'.\n";
+        return 1;
+    }
+
+    WorkingSet ws;
+    if (!corpusFile.empty()) {
+        vector<Grid> all;
+        if (!loadPuzzleFile(corpusFile, all)) {
+            cerr << "ERROR: Could not open " << corpusFile << ".\n";
+            return 1;
+        }
+        for (const Grid& p : all) {
+            if ((int)ws.puzzles.size() == puzzleCount) break;
+            if (validateClues(p)) ws.puzzles.push_back(p);
+        }
+    }
+    else {
+        PuzzleGenerator generator(1);
+        ws.puzzles.resize(puzzleCount);
+        for (Grid& p : ws.puzzles) generator.generate(Difficulty::Any, p);
+    }
+
+    SudokuSolver solver;
+    vector<Grid> solvable;
+    for (const Grid& p : ws.puzzles) {
+        if (!solver.solve(p)) continue;
+        solvable.push_back(p);
+        ws.solutions.push_back(solver.solution());
+        ws.grids.push_back(extractSolution(solver.solution()));
+    }
+    ws.puzzles.swap(solvable);
+    if (ws.puzzles.empty()) {
+        cerr << "ERROR: No solvable puzzles to benchmark.\n";
+        return 1;
+    }
+
+    PerfCounters counters;
+    if (!counters.available(CYCLES))
+        cerr << "Hardware counters unavailable; reporting times only.\n";
+
+    vector<MicroResult> results;
+    for (const MicroBench& b : makeMicroBenches(ws)) {
+        bool selected = filters.empty();
+        for (const string& f : filters) selected |= b.name.find(f) != string::npos;
+        if (selected) results.push_back(runMicro(b, counters, minMs));
+    }
+    if (results.empty()) {
+        cerr << "ERROR: No benchmark matches --filter.\n";
+        return 1;
+    }
+
+    ofstream fout;
+    if (!output.empty()) {
+        fout.open(output);
+        if (!fout) {
+            cerr << "ERROR: Could not open output file " << output << ".\n";
+            return 1;
+        }
+    }
+    ostream& out = output.empty() ? cout : fout;
+
+    if (format == "csv")       printMicroCsv(out, results);
+    else if (format == "json") printMicroJson(out, results);
+    else                       printMicroText(out, results);
+    return 0;
+}